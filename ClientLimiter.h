@@ -0,0 +1,234 @@
+//*********************************************************************
+//
+//  ClientLimiter.h ：
+//      1、定义 单个客户端的限流状态         : struct ClientLimiter__State;
+//      2、定义并实现 按客户端 IP 的限流     : class ClientLimiter;
+//
+//  功能特点：
+//      1、每个 IP 一个令牌桶（每秒补充 rate 个，最多积累 burst 个），建立连接与每个请求各消耗一个令牌；
+//      2、令牌不足时预占令牌并让请求等待至令牌补足（限速），需等待超过 maxDelay 毫秒时直接拒绝；
+//      3、每个 IP 的并发连接数不超过 maxConn，超出时在 accept 后立即断开；
+//      4、参数由环境变量 DDB_LIMITS 配置：“rate,burst,maxConn,maxDelay”，缺省见下方定义；
+//      5、统计被拒绝的连接、被限速与被拒绝的请求，并列出受影响最多的客户端；
+//
+//  制作信息：
+//      韩佩恩  2019 于 上海同济大学；
+//
+//*********************************************************************
+
+#if!defined CLIENTLIMITER_H
+#define CLIENTLIMITER_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <unordered_map>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <arpa/inet.h>
+#pragma once
+using namespace std;
+
+#define LIMIT_RATE          50      //每秒补充的令牌数；
+#define LIMIT_BURST         100     //令牌桶容量；
+#define LIMIT_MAXCONN       16      //单个 IP 的最大并发连接数；
+#define LIMIT_MAXDELAY      200     //限速时最长等待（毫秒），超出则拒绝；
+#define LIMIT_SWEEP         60      //清理空闲客户端的间隔（秒）；
+#define LIMIT_REPORTCLIENTS 10      //统计信息中列出的客户端数；
+#define LIMIT_CONNMSG       "TOO MANY CONNECTIONS"  //拒绝连接时发送的信息；
+#define LIMIT_RATEMSG       "RATE LIMITED"          //拒绝请求时返回的信息；
+
+//  单个客户端的限流状态；
+struct ClientLimiter__State{
+    ClientLimiter__State() : tokens(0.0),connections(0u),
+        connRejected(0u),throttled(0u),rejected(0u){}
+    double tokens;                  //当前令牌数（预占后可为负）；
+    chrono::steady_clock::time_point refillTime;    //上次补充时间；
+    size_t connections;             //当前连接数；
+    size_t connRejected , throttled , rejected;     //被拒绝的连接、被限速与被拒绝的请求；
+};
+
+//  按客户端 IP 的限流
+//  主要功能：1、accept 时检查连接数与令牌；2、每个请求取得令牌（或等待、或拒绝）；3、统计；
+class ClientLimiter{
+    public:
+        ClientLimiter(double rate = LIMIT_RATE , double burst = LIMIT_BURST ,
+                size_t maxConn = LIMIT_MAXCONN , long maxDelay = LIMIT_MAXDELAY)
+            : _rate_(rate),_burst_(burst),_maxConn_(maxConn),_maxDelay_(maxDelay),
+              _connRejected_(0u),_throttled_(0u),_rejected_(0u){ _sweepTime_ = chrono::steady_clock::now(); }
+        ClientLimiter(const ClientLimiter & limiter) = delete;
+        ClientLimiter & operator=(const ClientLimiter & limiter) = delete;
+
+        static ClientLimiter& Shared();         //全部连接共享的限流（首次使用时读取 DDB_LIMITS）；
+        bool Configure(const char* config);     //按 “rate,burst,maxConn,maxDelay” 设置参数（可只给前几项）；
+        bool TryConnect(uint32_t ip);           //登记新连接，超出连接数或令牌不足时返回 false；
+        void Disconnect(uint32_t ip);           //连接断开；
+        long Acquire(uint32_t ip);              //取得一个请求令牌：0 立即放行，>0 需等待的微秒数，<0 拒绝；
+        string Describe();                      //统计信息，每行：  “名称 数值” 或 “limit_client IP 连接数 拒绝连接/限速请求/拒绝请求”；
+
+    private:
+        double _rate_ , _burst_;
+        size_t _maxConn_;
+        long _maxDelay_;
+        unordered_map<uint32_t , ClientLimiter__State> _clients_;   //IP（网络字节序） -> 状态；
+        chrono::steady_clock::time_point _sweepTime_;
+        mutex _mutex_;
+        atomic<size_t> _connRejected_ , _throttled_ , _rejected_;
+
+        ClientLimiter__State& _Refill(uint32_t ip);     //取得状态并按时间补充令牌；
+        void _Sweep();                                  //清理无连接且令牌已满的客户端；
+        static string _Address(uint32_t ip);
+};
+
+
+//----------------------------------------------------------------------//
+//
+//              *******   函数实现   *******
+//
+
+//  全部连接共享的限流；
+ClientLimiter& ClientLimiter::Shared(){
+    static ClientLimiter limiter;
+    static once_flag flag;
+    call_once(flag , []{
+        const char* config = getenv("DDB_LIMITS");
+        if( config != nullptr )
+            limiter.Configure(config);
+    });
+    return limiter;
+}
+
+//  设置参数，格式错误时保持原参数；
+bool ClientLimiter::Configure(const char* config){
+    double rate = _rate_ , burst = _burst_;
+    unsigned long maxConn = _maxConn_;
+    long maxDelay = _maxDelay_;
+    if( sscanf(config , "%lf,%lf,%lu,%ld" , &rate , &burst , &maxConn , &maxDelay) < 1 ||
+            rate <= 0.0 || burst < 1.0 || maxConn == 0u || maxDelay < 0 ){
+        cout << "ERROR !\n\tClientLimiter: bad limits: " << config << endl;
+        return false;
+    }
+    lock_guard<mutex> lock(_mutex_);
+    _rate_ = rate;
+    _burst_ = burst;
+    _maxConn_ = maxConn;
+    _maxDelay_ = maxDelay;
+    return true;
+}
+
+//  登记新连接：连接本身也消耗一个令牌，防止反复建立连接绕过请求限速；
+bool ClientLimiter::TryConnect(uint32_t ip){
+    lock_guard<mutex> lock(_mutex_);
+    _Sweep();
+    ClientLimiter__State &state = _Refill(ip);
+    if( state.connections >= _maxConn_ || state.tokens < 1.0 ){
+        state.connRejected ++;
+        _connRejected_ ++;
+        return false;
+    }
+    state.tokens -= 1.0;
+    state.connections ++;
+    return true;
+}
+
+//  连接断开；
+void ClientLimiter::Disconnect(uint32_t ip){
+    lock_guard<mutex> lock(_mutex_);
+    auto it = _clients_.find(ip);
+    if( it != _clients_.end() && it->second.connections != 0u )
+        it->second.connections --;
+}
+
+//  取得请求令牌：令牌不足时预占，按欠额计算等待时间；等待超过 maxDelay 时拒绝且不预占；
+long ClientLimiter::Acquire(uint32_t ip){
+    lock_guard<mutex> lock(_mutex_);
+    ClientLimiter__State &state = _Refill(ip);
+    if( state.tokens >= 1.0 ){
+        state.tokens -= 1.0;
+        return 0;
+    }
+    double wait = ( 1.0 - state.tokens ) / _rate_;     //秒；
+    if( wait * 1000.0 > (double)_maxDelay_ ){
+        state.rejected ++;
+        _rejected_ ++;
+        return -1;
+    }
+    state.tokens -= 1.0;
+    state.throttled ++;
+    _throttled_ ++;
+    return max( 1L , (long)( wait * 1e6 ) );
+}
+
+//  统计信息：总数及受影响最多的客户端；
+string ClientLimiter::Describe(){
+    string res;
+    res  = "limit_connections_rejected " + to_string( _connRejected_.load() ) + "\n";
+    res += "limit_requests_throttled " + to_string( _throttled_.load() ) + "\n";
+    res += "limit_requests_rejected " + to_string( _rejected_.load() ) + "\n";
+    vector<pair<size_t , uint32_t> > clients;   //(受影响次数,IP)；
+    lock_guard<mutex> lock(_mutex_);
+    res += "limit_clients " + to_string( _clients_.size() ) + "\n";
+    for(auto &client : _clients_){
+        size_t hits = client.second.connRejected + client.second.throttled + client.second.rejected;
+        if( hits != 0u )
+            clients.push_back( make_pair(hits , client.first) );
+    }
+    size_t shown = min( clients.size() , (size_t)LIMIT_REPORTCLIENTS );
+    partial_sort(clients.begin() , clients.begin() + shown , clients.end() ,
+            [](const pair<size_t,uint32_t> &x , const pair<size_t,uint32_t> &y){ return x.first > y.first; });
+    for(size_t i=0u;i<shown;i++){
+        ClientLimiter__State &state = _clients_[ clients[i].second ];
+        res += "limit_client " + _Address(clients[i].second) + " " + to_string(state.connections) + " " +
+            to_string(state.connRejected) + "/" + to_string(state.throttled) + "/" + to_string(state.rejected) + "\n";
+    }
+    return res;
+}
+
+//  取得状态并补充令牌（新客户端令牌桶为满）；
+ClientLimiter__State& ClientLimiter::_Refill(uint32_t ip){
+    auto now = chrono::steady_clock::now();
+    auto it = _clients_.find(ip);
+    if( it == _clients_.end() ){
+        ClientLimiter__State &state = _clients_[ip];
+        state.tokens = _burst_;
+        state.refillTime = now;
+        return state;
+    }
+    ClientLimiter__State &state = it->second;
+    double elapsed = chrono::duration<double>( now - state.refillTime ).count();
+    state.tokens = min( _burst_ , state.tokens + elapsed * _rate_ );
+    state.refillTime = now;
+    return state;
+}
+
+//  每 LIMIT_SWEEP 秒清理一次：无连接且令牌已补满的客户端与新客户端无异，可以移除；
+void ClientLimiter::_Sweep(){
+    auto now = chrono::steady_clock::now();
+    if( now - _sweepTime_ < chrono::seconds(LIMIT_SWEEP) )
+        return;
+    _sweepTime_ = now;
+    for(auto it = _clients_.begin();it != _clients_.end();){
+        double elapsed = chrono::duration<double>( now - it->second.refillTime ).count();
+        if( it->second.connections == 0u && it->second.tokens + elapsed * _rate_ >= _burst_ )
+            it = _clients_.erase(it);
+        else
+            it ++;
+    }
+}
+
+//  IP 的点分十进制表示；
+string ClientLimiter::_Address(uint32_t ip){
+    char buf[INET_ADDRSTRLEN];
+    struct in_addr addr;
+    addr.s_addr = ip;
+    if( inet_ntop(AF_INET , &addr , buf , sizeof(buf)) == NULL )
+        return "?";
+    return buf;
+}
+
+#endif
@@ -4,19 +4,33 @@
 //      1、定义并实现 访问MySQL的对象   ：class MySQL_Root；
 //      2、定义 需求的常规操作          ：class Normal_Operator；
 //      3、定义并实现 需求的数据库操作  ：class Database_Operator；
+//      4、定义并实现 索引的后台更新线程  ：class Catalog_Refresher；
 //      3、定义并实现 对客户端服务线程任务于，包括收发信息和需求处理：class ServerTask；
 //
 ///  功能特点：
-//      1、MySQL保存有自定义过程，方便服务器进行调用；
+//      1、MySQL保存有自定义过程，方便服务器进行调用；支持多个只读从库，读请求按延迟路由（见 MySQLRouter.h）；
 //      2、支持应用层级的 心跳检测；
 //      3、ServerTask定义独立的线程池任务，可对不同客户端进行独立的响应；
 //      4、对MySQL返回的信息进行特定格式的编码返回客户端；
-//      5、特定的客户端请求格式，例如： “请求内容#请求方法”
+//      5、特定的客户端请求格式，例如： “请求内容#请求方法”，可选 “请求内容#请求方法#返回格式”
+//         返回格式：0 = 文本（默认，字段以 " | " 分隔）；1 = 二进制按行；2 = 二进制按列块（见 RowEncoder.h）；
+//         文本格式下结果为空时返回 “NO RESULT”，二进制格式返回零行的完整帧；
+//         错误信息在文本格式下为一行文字，在二进制格式下为错误帧（统计信息始终为文本）；
 //
 //  目前支持功能：
 //      1、按作者查询；
 //      2、按年份查询；
 //      3、查询所有文档；
+//      4、按作者模糊查询（容忍拼写错误、缩写及姓名顺序差异，结果按相似度排序）；
+//      5、结构化查询（年份区间、作者、标题子串的合取，服务器端排序与限量，格式见 QueryPlanner.h）；
+//      6、服务器统计信息（请求合并次数、各 MySQL 后端状态、限流拒绝与限速次数、线程池各线程的任务数与 CPU 迁移次数等）；
+//      7、增量同步：客户端给出上次的水位，仅返回此后新增、修改、删除的文档，并在结果尾部给出新水位
+//         （变更日志及水位的保证见 sql/ChangeLog.sql）；
+//      8、分面统计：按年份或作者分组计数、按计数取前 k，可附加过滤条件（由内存计数索引给出，见 FacetIndex.h）；
+//      9、输入提示：按前缀补全作者名与标题单词，按热度排序（由内存前缀索引给出，见 SuggestIndex.h）；
+//
+//  并发的相同查询（请求方法、返回格式与请求内容均相同，模糊作者按规范化后的内容比较）只访问一次数据库，共享同一编码结果；
+//  每个请求按客户端 IP 限流：超出速率时等待，等待过长时返回 “RATE LIMITED”（见 ClientLimiter.h）；
 //
 //  未来版本将增加功能：
 //      1、按学术领域查询；
@@ -44,19 +58,55 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <map>
+#include <vector>
+#include <functional>
 #include "ThreadPool.h"
+#include "FuzzyIndex.h"
+#include "FacetIndex.h"
+#include "SuggestIndex.h"
+#include "QueryPlanner.h"
+#include "RowEncoder.h"
+#include "SingleFlight.h"
+#include "MySQLRouter.h"
+#include "ClientLimiter.h"
 #include "mysql.h"
 
 //定义心跳检测 避免服务器误读；
 #define HEARTBEAT "HEARTBEAT"
 #define HEARTBEATSIZE 9
 #define MAXLINE 4096
-//定义 MySQL 的登陆信息；
-#define USERNAME    "***"
-#define PASSWORD    "***"
-#define HOST        "***"
-#define TABLE       "***"
-#define MYSQLPORT   3306
+//定义 返回结果的编码格式；
+#define FORMAT_TEXT     0
+#define FORMAT_ROWS     1
+#define FORMAT_COLUMNS  2
+//定义 文本格式下结果为空时的返回信息（避免客户端等待不到任何数据）；
+#define NORESULT        "NO RESULT\n"
+//定义 请求方法；
+#define OP_SHOWALL      0
+#define OP_YEAR         1
+#define OP_AUTHER       2
+#define OP_AUTHERFUZZY  3
+#define OP_QUERY        4
+#define OP_STATS        5
+#define OP_SYNC         6
+#define OP_FACET        7
+#define OP_TOPK         8
+#define OP_SUGGEST      9
+//定义 增量同步单次返回的最大变更数与安全水位的时间余量（秒，见 sql/ChangeLog.sql）；
+#define SYNC_MAXROWS    1000
+#define SYNC_SAFETYWINDOW 1
+//定义 连接级错误时改用其他后端重试的最大次数；
+#define MYSQL_MAXATTEMPT 3
+//定义 作者模糊查询 的返回作者数与索引刷新间隔（秒）；
+#define FUZZY_TOPN      10
+#define FUZZY_REFRESH   300
+//定义 分面统计 的索引更新间隔（秒）、前 k 的缺省值、分组计数的组数（不限）与每批读取的变更数；
+#define FACET_REFRESH   2
+#define FACET_TOPK      10
+#define FACET_NOLIMIT   ((size_t)-1)
+#define FACET_BATCHROWS 10000
+//定义 输入提示 的缺省返回数（上限为 SUGGEST_NODETOPK）；
+#define SUGGEST_TOPN    8
 
 #pragma comment(lib,"libmysql.lib")
 #pragma once
@@ -65,21 +115,22 @@ using namespace std;
 //  MySQL 类，用于实现连接数据库的基本工作；
 class MySQL_Root{
     public:
-        MySQL_Root(){ mysql_init(&_myCon_); _UserPlugin(); }//初始化和保存登陆信息；
+        MySQL_Root():_backend_(nullptr),_isReported_(false){ _UserPlugin(); }//取得后端路由；
         virtual ~MySQL_Root(){}
         string result;  //用于保存传给套接字的结果；
 
     protected:
-        char* _user_ ;      //用户名；
-        char* _pswd_ ;      //密码；
-        char* _host_ ;      //主机名；
-        char* _table_;      //表名；
-        unsigned int _port_;//端口；
+        MySQL_Router* _router_;         //后端路由；
+        MySQL_Backend* _backend_;       //当前连接的后端；
+        chrono::steady_clock::time_point _startTime_;  //本次连接开始时间；
+        bool _isReported_;              //本次连接的延迟是否已报告；
         MYSQL _myCon_;
         MYSQL_ROW _row_;
         string _commond_;   //用于保存发给MySQL的命令；
         void _UserPlugin(); //登录函数；
-        void _MySQLConnect();//连接函数；
+        bool _MySQLConnect(bool isWrite = false);   //连接函数（按路由依次尝试候选后端）；
+        void _MySQLReport(bool isHealthy);          //向路由报告本次延迟（连接至取回结果集）与健康状态；
+        void _MySQLClose(bool isHealthy);           //断开连接（尚未报告时一并报告）；
 };
 
 //  定义基本的操作
@@ -90,20 +141,73 @@ class Normal_Operator{
         virtual ~Normal_Operator(){}
         virtual void SearchByYear(string year) = 0;     //按年查找；
         virtual void SearchByAuther(string Auther) = 0; //按作者查找；
+        virtual void SearchByAutherFuzzy(string Auther) = 0;//按作者模糊查找；
+        virtual void SearchByQuery(string Query) = 0;   //结构化查询；
+        virtual void SyncSince(string Watermark) = 0;   //增量同步；
+        virtual void CountByFacet(string Facet) = 0;    //分面分组计数；
+        virtual void TopByFacet(string Facet) = 0;      //分面按计数取前 k；
+        virtual void SuggestByPrefix(string Prefix) = 0;//前缀输入提示；
         virtual void ShowAll() = 0;                     //显示全部数据；
 };
 
 //  数据库具体操作的实现
 class Database_Operator : public Normal_Operator ,public MySQL_Root {
     public:
-        Database_Operator() : MySQL_Root(){}
+        Database_Operator() : MySQL_Root(),_format_(FORMAT_TEXT),_usePrimary_(false){}
         virtual ~Database_Operator(){}
         void SearchByYear(string Year);     //按年查找；
         void SearchByAuther(string Auther); //按作者查找；
+        void SearchByAutherFuzzy(string Auther);//按作者模糊查找；
+        void SearchByQuery(string Query);   //结构化查询；
+        void SyncSince(string Watermark);   //增量同步；
+        void CountByFacet(string Facet);    //分面分组计数；
+        void TopByFacet(string Facet);      //分面按计数取前 k；
+        void SuggestByPrefix(string Prefix);//前缀输入提示；
         void ShowAll();                     //显示全部数据；
 
     protected:
-        void _RunCommond(int ResRowNum);    //执行具体命令；
+        int _format_;                       //返回结果的编码格式；
+        bool _usePrimary_;                  //只访问主库（变更日志须按主库的提交情况读取）；
+        void _RunCommond(int ResRowNum , const vector<pair<string,string> > &trailer =
+                vector<pair<string,string> >());    //执行具体命令（trailer 为附在结果尾部的名称与取值）；
+        MYSQL_RES* _Query(string &error);   //连接并执行 _commond_，返回结果集（调用者释放并断开）；
+        bool _QueryColumn(vector<string> &column);  //执行命令并取回首列；
+        bool _QueryRows(size_t fieldNum , vector<string> &cells);  //执行命令并按行取回前 fieldNum 列（NULL 为空串）；
+        bool _ResolveFuzzy(QueryPlan &plan);        //经作者模糊索引解析 auther~ ，返回结果是否可能非空；
+        void _Facet(const string &parameter , bool byCount);   //分面统计；
+        void _EncodeRows(const vector<string> &names , const vector<vector<string> > &rows ,
+                const vector<pair<string,string> > &trailer =
+                vector<pair<string,string> >());    //按 _format_ 编码内存索引给出的结果；
+        void _Fail(const string &message);  //按 _format_ 返回错误信息（二进制格式为错误帧）；
+        bool _ChangeLogBounds(unsigned long long &minSeq , unsigned long long &maxSeq ,
+                unsigned long long &safeSeq);       //变更日志的保留范围与安全水位（在主库上查询）；
+        void _RefreshFuzzyIndex();          //按需重建作者模糊索引；
+        void _RefreshCatalog();             //以快照或变更日志更新分面索引与前缀索引；
+        static void _StartCatalogRefresh(); //启动分面索引与前缀索引的后台更新（仅首次调用生效）；
+        static FuzzyAutherIndex& _FuzzyIndex();     //全部连接共享的作者模糊索引；
+        static FacetIndex& _Facets();               //全部连接共享的分面索引；
+        static PrefixSuggester& _Suggester(PrefixSuggester::Kind kind);//全部连接共享的前缀索引；
+};
+
+//  分面索引与前缀索引的后台更新线程
+//  主要功能：每 FACET_REFRESH 秒执行一次更新，请求线程只读取当前索引，不承担更新的数据库访问；
+class Catalog_Refresher{
+    public:
+        explicit Catalog_Refresher(const function<void()> &refresh) : _refresh_(refresh),_isEnd_(false){
+            _refreshThread_ = thread(&Catalog_Refresher::_Refresh , this);
+        }
+        ~Catalog_Refresher();
+        Catalog_Refresher(const Catalog_Refresher & refresher) = delete;
+        Catalog_Refresher & operator=(const Catalog_Refresher & refresher) = delete;
+
+    private:
+        function<void()> _refresh_;     //单次更新；
+        thread _refreshThread_;
+        atomic<bool> _isEnd_;
+        mutex _mutexEnd_;
+        condition_variable _conditionEnd_;
+
+        void _Refresh();
 };
 
 //  线程池任务对象，用于实现具体的响应操作
@@ -116,14 +220,20 @@ class ServerTask : public ThreadPool__Task , public Database_Operator{
     private:
         int _recvStatus_ , _sendStatus_;    //收发状态；
         int _confd_;                        //客户端信息；
-        char _ipstr_[128] , _buf_[MAXLINE]; //socket信息存储空间；
+        char _ipstr_[128];                  //socket信息存储空间；
+        char* _buf_;                        //接收缓冲（执行线程的局部缓冲，位于该线程所在 NUMA 节点）；
         struct sockaddr_in _clientAddr_;    //客户端；
         map<int,int>* _heartCount_;         //心跳检测对象表；
         char* _heartChar_;                  //心跳检测密码；
+        SingleFlight::Response _response_;  //待发送的编码结果（可能与其他连接共享）；
 
         void _CommondAnalyse();             //分析客户端 需求代码，格式：  “查询信息#查询属性”；
+        void _Execute(int operatorNum , const string &parameter);   //执行具体需求，结果存入 result；
+        void _ShowStats();                  //服务器统计信息；
         bool _Send();                       //发送函数；
         bool _Receive();                    //接收函数（执行客户端需求）；
+        static SingleFlight& _SingleFlight();   //全部连接共享的请求合并表；
+        static string _FlightKey(int operatorNum , int format , const string &parameter);//合并键值；
 };
 
 //-------------------------------------------------------------------------------
@@ -131,55 +241,120 @@ class ServerTask : public ThreadPool__Task , public Database_Operator{
 //                   *******      函数实现      *******
 //
 
-//  MySQL登录信息存储；
+//  MySQL登录信息（由路由统一管理）；
 void MySQL_Root::_UserPlugin(){
-    _user_   =   USERNAME;
-    _pswd_   =   PASSWORD;
-    _host_   =   HOST;
-    _table_  =   TABLE;
-    _port_   =   MYSQLPORT;
-}
-//  连接MySQL;
-void MySQL_Root::_MySQLConnect(){
-    if(mysql_real_connect(&_myCon_ , _host_ , _user_ , _pswd_ , _table_ , _port_ , NULL , 0))
-        cout << "mySQL connect succeed !" << endl;
-    else{
-        cout << "ERROR !\n\tMySQL Connect Failed !" << endl;
-        exit(1);
+    _router_ = &MySQL_Router::Shared();
+}
+//  连接MySQL：按路由顺序尝试，连接失败的后端被标记为异常；
+bool MySQL_Root::_MySQLConnect(bool isWrite){
+    unsigned int timeout = ROUTER_CONNECTTIMEOUT;
+    for(auto backend : _router_->Route(isWrite)){
+        _startTime_ = chrono::steady_clock::now();
+        mysql_init(&_myCon_);
+        mysql_options(&_myCon_ , MYSQL_OPT_CONNECT_TIMEOUT , &timeout);
+        if(mysql_real_connect(&_myCon_ , backend->host.c_str() , backend->user.c_str() , backend->pswd.c_str() ,
+                    backend->database.c_str() , backend->port , NULL , 0)){
+            _backend_ = backend;
+            _isReported_ = false;
+            return true;
+        }
+        cout << "ERROR !\n\tMySQL Connect Failed : " << backend->host << ":" << backend->port << endl;
+        mysql_close(&_myCon_);
+        _router_->Report(backend , false , 0.0);
     }
+    _backend_ = nullptr;
+    return false;
+}
+//  报告延迟：只计 MySQL 的耗时（连接、执行、取回结果集），不含其后逐行读取与编码的时间；
+void MySQL_Root::_MySQLReport(bool isHealthy){
+    if( _isReported_ )
+        return;
+    double ms = chrono::duration<double , milli>( chrono::steady_clock::now() - _startTime_ ).count();
+    _router_->Report(_backend_ , isHealthy , ms);
+    _isReported_ = true;
+}
+//  断开连接；
+void MySQL_Root::_MySQLClose(bool isHealthy){
+    mysql_close(&_myCon_);
+    _MySQLReport(isHealthy);
+    _backend_ = nullptr;
 }
 
 //  执行客户端需求的命令（存储于 MySQL_Root :: _commond_ 中）；
-void Database_Operator::_RunCommond(int ResRowNum){
+//  结果按 _format_ 编码，输出缓冲依据行数与字段最大长度一次性预分配；
+void Database_Operator::_RunCommond(int ResRowNum , const vector<pair<string,string> > &trailer){
     result = "";        //结果清零
-    _MySQLConnect();    //连接至数据库
-    //进行操作请求
-    if(mysql_real_query( &_myCon_ , _commond_.data() , (unsigned long) _commond_.length() ) ){
-        cout << "mysql_real_query failure : " << _commond_  << endl;
-        result =  "mysql_real_query failure " ;  
-        return;
-    }
-    //保存请求结果；
-    MYSQL_RES * _res_ = mysql_store_result( &_myCon_ );
+    //连接至数据库，进行操作请求并保存请求结果；
+    string error;
+    MYSQL_RES * _res_ = _Query( error );
     if( _res_ == NULL ){
-        cout << "Result is NULL !" << endl;
-        result =  "Result is NULL !";
-        mysql_free_result(_res_);
+        _Fail( error );
         return;
     }
     else{
-        //存储结果至 result 中；
-        while( _row_ = mysql_fetch_row( _res_ ) ){
-            for(int field = 0;field<ResRowNum;field++){
-                result += _row_[field] ;
-                result += " | " ;
+        size_t fieldNum = min( (size_t)ResRowNum , (size_t)mysql_num_fields(_res_) );
+        uint64_t rowNum = mysql_num_rows(_res_);
+        size_t rowBytes = 1u;
+        for(size_t field = 0u;field<fieldNum;field++)
+            rowBytes += mysql_fetch_field_direct(_res_ , field)->max_length + 4u;
+        if( _format_ == FORMAT_TEXT ){
+            //存储结果至 result 中；
+            result.reserve( rowNum * rowBytes );
+            while( _row_ = mysql_fetch_row( _res_ ) )
+                RowEncoder::AppendText( result , _row_ , mysql_fetch_lengths( _res_ ) , fieldNum );
+            if( result.empty() && trailer.empty() )
+                result = NORESULT;
+            for(auto &item : trailer)
+                result += item.first + " " + item.second + "\n";
+        } else {
+            //二进制编码：作者字段使用字典编码；
+            vector<string> names(fieldNum);
+            vector<bool> dictionary(fieldNum , false);
+            for(size_t field = 0u;field<fieldNum;field++){
+                names[field] = mysql_fetch_field_direct(_res_ , field)->name;
+                dictionary[field] = ( names[field] == "Auther" );
             }
-            result += "\n" ;
+            RowEncoder encoder;
+            encoder.Begin( result , _format_ == FORMAT_COLUMNS ? RowEncoder::COLUMNS : RowEncoder::ROWS ,
+                    names , dictionary , rowNum , 64u + rowNum * rowBytes );
+            while( _row_ = mysql_fetch_row( _res_ ) )
+                encoder.AddRow( _row_ , mysql_fetch_lengths( _res_ ) );
+            encoder.Finish(trailer);
         }
         mysql_free_result(_res_);
     }
     //断开数据库连接；
-    mysql_close(&_myCon_);
+    _MySQLClose(true);
+}
+
+//  连接并执行 _commond_：连接级错误（客户端错误码）时标记该后端异常，并改用下一候选后端重试；
+//  失败时返回 NULL 且 error 给出原因，连接已断开；
+MYSQL_RES* Database_Operator::_Query(string &error){
+    for(int attempt=0;attempt<MYSQL_MAXATTEMPT;attempt++){
+        if( !_MySQLConnect(_usePrimary_) ){
+            error = "MySQL Connect Failed !";
+            return NULL;
+        }
+        if(mysql_real_query( &_myCon_ , _commond_.data() , (unsigned long) _commond_.length() ) ){
+            bool isLost = ( mysql_errno(&_myCon_) >= 2000u );
+            cout << "mysql_real_query failure : " << _commond_  << endl;
+            _MySQLClose( !isLost );
+            if( isLost )
+                continue;
+            error = "mysql_real_query failure ";
+            return NULL;
+        }
+        MYSQL_RES * res = mysql_store_result( &_myCon_ );
+        _MySQLReport(true);     //结果集已在客户端，此后的读取与编码不计入后端延迟；
+        if( res == NULL ){
+            cout << "Result is NULL !" << endl;
+            error = "Result is NULL !";
+            _MySQLClose(true);
+        }
+        return res;
+    }
+    error = "mysql_real_query failure ";
+    return NULL;
 }
 
 //  按年查找；
@@ -195,6 +370,447 @@ void Database_Operator::SearchByAuther(string Auther){
     _RunCommond(2);
 }
 
+//  按作者模糊查找：索引给出按相似度排序的作者，再一次性取回其文档；
+void Database_Operator::SearchByAutherFuzzy(string Auther){
+    _RefreshFuzzyIndex();
+    vector<FuzzyAutherMatch> matches = _FuzzyIndex().Search(Auther , FUZZY_TOPN);
+    if( matches.empty() ){
+        _Fail( "NO MATCH" );
+        return;
+    }
+    string names , order;
+    for(size_t i=0u;i<matches.size();i++){
+        string name = "'" + QueryPlanner::Escape(matches[i].auther) + "'";
+        names += ( i == 0u ? "" : "," ) + name;
+        order += "," + name;
+    }
+    _commond_ = "SELECT Year,Auther,Title FROM test WHERE Auther IN (" + names +
+        ") ORDER BY FIELD(Auther" + order + "),Year;";
+    _RunCommond(3);
+}
+
+//  结构化查询：解析为执行计划，模糊作者先经索引解析，矛盾谓词不访问数据库（返回空结果）；
+void Database_Operator::SearchByQuery(string Query){
+    QueryPlan plan;
+    string error;
+    if( !QueryPlanner::Parse(Query , plan , error) ){
+        _Fail( "WRONG QUERY: " + error );
+        return;
+    }
+    if( !_ResolveFuzzy(plan) ){
+        _EncodeRows( vector<string>{ "Year" , "Auther" , "Title" } , vector<vector<string> >() );
+        return;
+    }
+    _commond_ = QueryPlanner::BuildSQL(plan);
+    _RunCommond(3);
+}
+
+//  经作者模糊索引解析 auther~ （同时给出精确作者时取交集）；
+bool Database_Operator::_ResolveFuzzy(QueryPlan &plan){
+    if( plan.autherFuzzy && !plan.isEmpty ){
+        _RefreshFuzzyIndex();
+        vector<string> resolved;
+        for(auto &match : _FuzzyIndex().Search(plan.autherText , FUZZY_TOPN)){
+            if( plan.authers.empty() || plan.authers[0] == match.auther )
+                resolved.push_back(match.auther);
+        }
+        plan.authers = resolved;
+        if( resolved.empty() )
+            plan.isEmpty = true;
+    }
+    return !plan.isEmpty;
+}
+
+//  增量同步    请求格式：  “[水位][;条数上限]#6”，不给出水位（如 “#6”）表示请求快照，水位 0 为普通水位；
+//  返回列：Seq , Op , DocId , Year , Auther , Title ，按 Seq 升序，每个文档只返回其最新一次变更；
+//      Op = 'I' / 'U'：新增或修改（客户端按 DocId 覆盖）；'D'：删除；
+//      Op = 'S'：快照（未给出水位、水位早于日志保留范围或晚于最新变更时返回全表，客户端清空本地副本后重建）；
+//  结果尾部总是给出新水位（文本为末行 “WATERMARK 新水位”，二进制为尾部项 WATERMARK），没有变更时同样返回；
+//  只返回不超过安全水位的变更（见 _ChangeLogBounds），客户端以新水位再次同步不会遗漏尚未提交的变更；
+//  返回行数等于条数上限时应立即再次同步；
+void Database_Operator::SyncSince(string Watermark){
+    char* endPtr = const_cast<char*>( Watermark.c_str() );
+    while( isspace((unsigned char)*endPtr) )
+        endPtr ++;
+    bool isSnapshot = ( *endPtr == '\0' || *endPtr == ';' );
+    unsigned long long watermark = 0u , limit = SYNC_MAXROWS;
+    bool isWrong = !isSnapshot && !isdigit((unsigned char)*endPtr);
+    if( !isSnapshot && !isWrong )
+        watermark = strtoull(endPtr , &endPtr , 10);
+    if( *endPtr == ';' ){
+        isWrong = isWrong || !isdigit((unsigned char)endPtr[1]);
+        limit = strtoull(endPtr + 1 , &endPtr , 10);
+    }
+    while( isspace((unsigned char)*endPtr) )
+        endPtr ++;
+    if( isWrong || *endPtr != '\0' || limit == 0u ){
+        _Fail( "WRONG WATERMARK" );
+        return;
+    }
+    limit = min(limit , (unsigned long long)SYNC_MAXROWS);
+
+    //  日志保留范围与安全水位，变更日志均在主库上读取；
+    _usePrimary_ = true;
+    unsigned long long minSeq = 0u , maxSeq = 0u , safeSeq = 0u;
+    if( !_ChangeLogBounds(minSeq , maxSeq , safeSeq) ){
+        _usePrimary_ = false;
+        _Fail( "SYNC FAILURE" );
+        return;
+    }
+    vector<pair<string,string> > trailer( 1u , make_pair(string("WATERMARK") , string()) );
+    if( isSnapshot || watermark > maxSeq || ( minSeq != 0u && watermark + 1u < minSeq ) ){
+        //  快照：新水位为快照前的安全水位，其间的变更将在下次同步中重复下发（按 DocId 覆盖，结果一致）；
+        trailer[0].second = to_string(safeSeq);
+        _commond_ = "SELECT " + to_string(safeSeq) + " AS Seq,'S' AS Op,Id AS DocId,Year,Auther,Title "
+            "FROM test ORDER BY Id;";
+    } else {
+        //  (水位,安全水位] 内的变更均已提交且不再变化，先求本页的末个 Seq 与行数，再取回本页；
+        string latest = "SELECT DocId,MAX(Seq) AS Seq FROM test_changelog WHERE Seq>" + to_string(watermark) +
+            " AND Seq<=" + to_string(safeSeq) + " AND Op<>'N' GROUP BY DocId";
+        vector<string> cells;
+        _commond_ = "SELECT IFNULL(MAX(Seq),0),COUNT(*) FROM (" + latest + " ORDER BY Seq LIMIT " +
+            to_string(limit) + ") p;";
+        if( !_QueryRows(2u , cells) || cells.size() != 2u ){
+            _usePrimary_ = false;
+            _Fail( "SYNC FAILURE" );
+            return;
+        }
+        unsigned long long pageSeq = strtoull(cells[0].c_str() , NULL , 10);
+        unsigned long long rows = strtoull(cells[1].c_str() , NULL , 10);
+        trailer[0].second = to_string( rows < limit ? max(watermark , safeSeq) : pageSeq );
+        _commond_ = "SELECT c.Seq,c.Op,c.DocId,c.Year,c.Auther,c.Title FROM test_changelog c "
+            "JOIN (" + latest + ") l ON c.Seq=l.Seq ORDER BY c.Seq LIMIT " + to_string(limit) + ";";
+    }
+    _RunCommond(6 , trailer);
+    _usePrimary_ = false;
+}
+
+//  变更日志的保留范围与安全水位：AUTO_INCREMENT 的 Seq 在分配时递增，但事务可能乱序提交，
+//  最大 Seq 之下可能仍有未提交的变更；安全水位只取写入时间（ChangedAt，触发器内的 SYSDATE(6)）
+//  早于全部进行中事务的开始时间且留有 SYNC_SAFETYWINDOW 秒余量的最大 Seq，其下的变更均已提交或已回滚；
+//  需在主库上以具有 PROCESS 权限的账号查询（读取 information_schema.innodb_trx）；
+//  日志中始终有建表时写入的起始行（Op = 'N'，见 sql/ChangeLog.sql），最小 Seq 之下的空缺只来自清理，
+//  因此以安全水位再次同步不会被误判为早于保留范围；安全水位按 Seq 倒序取首个满足条件的行（主键逆序扫描）；
+bool Database_Operator::_ChangeLogBounds(unsigned long long &minSeq , unsigned long long &maxSeq ,
+        unsigned long long &safeSeq){
+    vector<string> cells;
+    _commond_ = "SELECT IFNULL(MIN(Seq),0),IFNULL(MAX(Seq),0),IFNULL((SELECT Seq FROM test_changelog "
+        "WHERE ChangedAt<(SELECT IFNULL(MIN(trx_started),NOW(6)) FROM information_schema.innodb_trx "
+        "WHERE trx_mysql_thread_id<>CONNECTION_ID())-INTERVAL " + to_string(SYNC_SAFETYWINDOW) + " SECOND "
+        "ORDER BY Seq DESC LIMIT 1),0) FROM test_changelog;";
+    if( !_QueryRows(3u , cells) || cells.size() != 3u )
+        return false;
+    minSeq = strtoull(cells[0].c_str() , NULL , 10);
+    maxSeq = strtoull(cells[1].c_str() , NULL , 10);
+    safeSeq = strtoull(cells[2].c_str() , NULL , 10);
+    return true;
+}
+
+//  分面分组计数    请求格式：  “year|auther[;过滤条件][;limit=n]#7”，按取值升序返回 “取值 计数”，
+//  缺省返回全部分组（分组由内存索引给出，不受结构化查询的 QUERY_MAXLIMIT 限制）；
+void Database_Operator::CountByFacet(string Facet){
+    _Facet(Facet , false);
+}
+
+//  分面按计数取前 k    请求格式：  “year|auther[;过滤条件][;limit=k]#8”，k 缺省为 FACET_TOPK，不设上限；
+void Database_Operator::TopByFacet(string Facet){
+    _Facet(Facet , true);
+}
+
+//  分面统计：首项为分组维度，其后为结构化查询的年份与作者谓词（见 QueryPlanner.h），
+//  不支持 title~（分面索引不保存标题），order 被忽略（计数按取值升序，前 k 按计数降序）；
+void Database_Operator::_Facet(const string &parameter , bool byCount){
+    size_t split = parameter.find(';');
+    string dimension = parameter.substr(0 , split);
+    while( !dimension.empty() && isspace((unsigned char)dimension.back()) )
+        dimension.pop_back();
+    for(auto &c : dimension) c = tolower(c);
+    if( dimension != "year" && dimension != "auther" ){
+        _Fail( "WRONG FACET: unknown dimension " + dimension );
+        return;
+    }
+    QueryPlan plan;
+    string error;
+    plan.limit = byCount ? FACET_TOPK : FACET_NOLIMIT;
+    if( split != string::npos &&
+            !QueryPlanner::Parse(parameter.substr(split + 1u) , plan , error , false , FACET_NOLIMIT) ){
+        _Fail( "WRONG FACET: " + error );
+        return;
+    }
+    if( !plan.titleWords.empty() ){
+        _Fail( "WRONG FACET: title is not supported" );
+        return;
+    }
+
+    FacetIndex::Dimension facet = ( dimension == "year" ) ? FacetIndex::YEAR : FacetIndex::AUTHER;
+    vector<string> names(2);
+    names[0] = ( facet == FacetIndex::YEAR ) ? "Year" : "Auther";
+    names[1] = "Count";
+    _StartCatalogRefresh();
+    if( !_Facets().IsLoaded() )
+        _RefreshCatalog();
+    if( !_Facets().IsLoaded() ){
+        _Fail( "FACET INDEX UNAVAILABLE" );
+        return;
+    }
+    vector<vector<string> > rows;
+    if( _ResolveFuzzy(plan) ){
+        FacetFilter filter;
+        filter.yearLow = plan.yearLow;
+        filter.yearHigh = plan.yearHigh;
+        filter.authers = plan.authers;
+        for(auto &group : _Facets().Count(facet , filter , byCount , plan.limit)){
+            vector<string> row(2);
+            row[0] = group.first;
+            row[1] = to_string(group.second);
+            rows.push_back(row);
+        }
+    }
+    _EncodeRows(names , rows);
+}
+
+//  前缀输入提示    请求格式：  “[auther:|title:]前缀[;limit=n]#9”，
+//  返回列：Kind（auther / title） , Term , Count（包含该词条的文档数），按 Count 降序；未限定类别时两类合并排序；
+//  没有补全时同样返回（文本为 “NO RESULT”，二进制为零行），客户端无需以超时判断；
+void Database_Operator::SuggestByPrefix(string Prefix){
+    size_t topN = SUGGEST_TOPN;
+    size_t split = Prefix.rfind(";limit=");
+    if( split != string::npos ){
+        char* endPtr = nullptr;
+        long limit = strtol(Prefix.c_str() + split + 7u , &endPtr , 10);
+        if( *endPtr != '\0' || limit <= 0 ){
+            _Fail( "WRONG SUGGEST: bad limit" );
+            return;
+        }
+        topN = min( (size_t)limit , (size_t)SUGGEST_NODETOPK );
+        Prefix.erase(split);
+    }
+    bool wantAuther = true , wantTitle = true;
+    if( Prefix.compare(0 , 7u , "auther:") == 0 ){
+        wantTitle = false;
+        Prefix.erase(0 , 7u);
+    } else if( Prefix.compare(0 , 6u , "title:") == 0 ){
+        wantAuther = false;
+        Prefix.erase(0 , 6u);
+    }
+    if( PrefixSuggester::Normalize(Prefix).empty() ){
+        _Fail( "WRONG SUGGEST: empty prefix" );
+        return;
+    }
+
+    _StartCatalogRefresh();
+    if( !_Facets().IsLoaded() )
+        _RefreshCatalog();
+    if( !_Facets().IsLoaded() ){
+        _Fail( "SUGGEST INDEX UNAVAILABLE" );
+        return;
+    }
+    vector<pair<const char* , SuggestMatch> > matches;
+    if( wantAuther )
+        for(auto &match : _Suggester(PrefixSuggester::AUTHER).Suggest(Prefix , topN))
+            matches.push_back( make_pair("auther" , match) );
+    if( wantTitle )
+        for(auto &match : _Suggester(PrefixSuggester::TITLE).Suggest(Prefix , topN))
+            matches.push_back( make_pair("title" , match) );
+    stable_sort(matches.begin(),matches.end(),[](const pair<const char*,SuggestMatch> &x ,
+                const pair<const char*,SuggestMatch> &y){ return x.second.count > y.second.count; });
+    if( matches.size() > topN )
+        matches.resize(topN);
+
+    vector<string> names = { "Kind" , "Term" , "Count" };
+    vector<vector<string> > rows;
+    for(auto &match : matches){
+        vector<string> row = { match.first , match.second.term , to_string(match.second.count) };
+        rows.push_back(row);
+    }
+    _EncodeRows(names , rows);
+}
+
+//  按 _format_ 编码内存索引给出的结果（与 _RunCommond 的输出格式一致，无结果时文本为 NORESULT，二进制为零行）；
+void Database_Operator::_EncodeRows(const vector<string> &names , const vector<vector<string> > &rows ,
+        const vector<pair<string,string> > &trailer){
+    result = "";
+    size_t fieldNum = names.size();
+    RowEncoder encoder;
+    if( _format_ != FORMAT_TEXT )
+        encoder.Begin( result , _format_ == FORMAT_COLUMNS ? RowEncoder::COLUMNS : RowEncoder::ROWS ,
+                names , vector<bool>(fieldNum , false) , rows.size() , 64u + rows.size() * 16u * fieldNum );
+    vector<const char*> fields(fieldNum);
+    vector<unsigned long> lengths(fieldNum);
+    for(auto &row : rows){
+        for(size_t field = 0u;field<fieldNum;field++){
+            fields[field] = row[field].c_str();
+            lengths[field] = (unsigned long)row[field].size();
+        }
+        if( _format_ == FORMAT_TEXT )
+            RowEncoder::AppendText( result , fields.data() , lengths.data() , fieldNum );
+        else
+            encoder.AddRow( fields.data() , lengths.data() );
+    }
+    if( _format_ != FORMAT_TEXT ){
+        encoder.Finish(trailer);
+        return;
+    }
+    if( result.empty() && trailer.empty() )
+        result = NORESULT;
+    for(auto &item : trailer)
+        result += item.first + " " + item.second + "\n";
+}
+
+//  返回错误信息：文本格式为信息本身，二进制格式为错误帧（见 RowEncoder.h），客户端均可按帧读取；
+void Database_Operator::_Fail(const string &message){
+    if( _format_ == FORMAT_TEXT )
+        result = message;
+    else
+        RowEncoder::EncodeError( result , message );
+}
+
+//  执行命令（存储于 _commond_ 中）并将结果首列存入 column；
+bool Database_Operator::_QueryColumn(vector<string> &column){
+    string error;
+    MYSQL_RES * _res_ = _Query( error );
+    if( _res_ == NULL )
+        return false;
+    while( _row_ = mysql_fetch_row( _res_ ) ){
+        if( _row_[0] != NULL )
+            column.push_back( _row_[0] );
+    }
+    mysql_free_result(_res_);
+    _MySQLClose(true);
+    return true;
+}
+
+//  执行命令（存储于 _commond_ 中）并将结果各行的前 fieldNum 列依次存入 cells；
+bool Database_Operator::_QueryRows(size_t fieldNum , vector<string> &cells){
+    string error;
+    MYSQL_RES * _res_ = _Query( error );
+    if( _res_ == NULL )
+        return false;
+    fieldNum = min( fieldNum , (size_t)mysql_num_fields(_res_) );
+    cells.reserve( cells.size() + mysql_num_rows(_res_) * fieldNum );
+    while( _row_ = mysql_fetch_row( _res_ ) ){
+        unsigned long* lengths = mysql_fetch_lengths( _res_ );
+        for(size_t field = 0u;field<fieldNum;field++)
+            cells.push_back( _row_[field] == NULL ? string() : string(_row_[field] , lengths[field]) );
+    }
+    mysql_free_result(_res_);
+    _MySQLClose(true);
+    return true;
+}
+
+//  索引为空或超过 FUZZY_REFRESH 秒未更新时重建（仅一个线程执行重建）；
+void Database_Operator::_RefreshFuzzyIndex(){
+    FuzzyAutherIndex &index = _FuzzyIndex();
+    if( index.Size() != 0u && time(NULL) - index.BuildTime() < FUZZY_REFRESH )
+        return;
+    if( !index.TryBeginBuild() )
+        return;
+    vector<string> authers;
+    _commond_ = "SELECT DISTINCT Auther FROM test;";
+    if( _QueryColumn(authers) )
+        index.Build(authers);
+    else
+        index.AbortBuild();
+}
+
+//  更新分面索引与前缀索引（仅一个线程执行，其余线程使用当前索引）：由后台线程每 FACET_REFRESH 秒调用，
+//  尚未加载时由请求线程调用一次；未加载或水位不在日志保留范围内时由全表快照重建，否则按 Seq 顺序分批应用变更日志；
+//  与增量同步相同，只应用不超过安全水位的变更（见 _ChangeLogBounds），不会越过尚未提交的变更；
+//  两类索引由同一批变更更新，以分面索引的水位为准；
+void Database_Operator::_RefreshCatalog(){
+    FacetIndex &index = _Facets();
+    PrefixSuggester &authers = _Suggester(PrefixSuggester::AUTHER);
+    PrefixSuggester &titles = _Suggester(PrefixSuggester::TITLE);
+    if( !index.TryBeginRefresh() )
+        return;
+    _usePrimary_ = true;
+    unsigned long long minSeq = 0u , maxSeq = 0u , safeSeq = 0u;
+    if( !_ChangeLogBounds(minSeq , maxSeq , safeSeq) ){
+        _usePrimary_ = false;
+        index.EndRefresh();
+        return;
+    }
+    vector<string> cells;
+    unsigned long long watermark = index.Watermark();
+    vector<FacetChange> changes;
+    if( !index.IsLoaded() || watermark > maxSeq || ( minSeq != 0u && watermark + 1u < minSeq ) ){
+        //  快照：水位取快照前的安全水位，其间的变更将在下次更新中重复应用（按 DocId 覆盖，结果一致）；
+        _commond_ = "SELECT Id,Year,Auther,Title FROM test;";
+        if( _QueryRows(4u , cells) ){
+            changes.resize(cells.size() / 4u);
+            for(size_t i=0u;i<changes.size();i++){
+                changes[i].seq = safeSeq;
+                changes[i].op = 'S';
+                changes[i].docId = atoi( cells[4u*i].c_str() );
+                changes[i].year = atoi( cells[4u*i + 1u].c_str() );
+                changes[i].auther = cells[4u*i + 2u];
+                changes[i].title = cells[4u*i + 3u];
+            }
+            authers.Reset(changes , safeSeq);
+            titles.Reset(changes , safeSeq);
+            index.Reset(changes , safeSeq);
+        }
+        _usePrimary_ = false;
+        index.EndRefresh();
+        return;
+    }
+    while( true ){
+        cells.clear();
+        _commond_ = "SELECT Seq,Op,DocId,Year,Auther,Title FROM test_changelog WHERE Seq>" + to_string(watermark) +
+            " AND Seq<=" + to_string(safeSeq) + " AND Op<>'N' ORDER BY Seq LIMIT " + to_string(FACET_BATCHROWS) + ";";
+        if( !_QueryRows(6u , cells) )
+            break;
+        changes.resize(cells.size() / 6u);
+        for(size_t i=0u;i<changes.size();i++){
+            changes[i].seq = strtoull( cells[6u*i].c_str() , NULL , 10 );
+            changes[i].op = cells[6u*i + 1u].empty() ? 'U' : cells[6u*i + 1u][0];
+            changes[i].docId = atoi( cells[6u*i + 2u].c_str() );
+            changes[i].year = atoi( cells[6u*i + 3u].c_str() );
+            changes[i].auther = cells[6u*i + 4u];
+            changes[i].title = cells[6u*i + 5u];
+        }
+        authers.Apply(changes);
+        titles.Apply(changes);
+        index.Apply(changes);
+        if( changes.size() < FACET_BATCHROWS )
+            break;
+        watermark = changes.back().seq;
+    }
+    _usePrimary_ = false;
+    index.EndRefresh();
+}
+
+//  启动后台更新：更新线程晚于索引与路由构造，因而先于它们析构，退出时不会访问已析构的索引；
+void Database_Operator::_StartCatalogRefresh(){
+    _Facets();
+    _Suggester(PrefixSuggester::AUTHER);
+    _Suggester(PrefixSuggester::TITLE);
+    MySQL_Router::Shared();
+    static Catalog_Refresher refresher([]{
+        Database_Operator refreshOperator;
+        refreshOperator._RefreshCatalog();
+    });
+}
+
+//  全部连接共享的分面索引；
+FacetIndex& Database_Operator::_Facets(){
+    static FacetIndex index;
+    return index;
+}
+
+//  全部连接共享的前缀索引（作者、标题单词各一）；
+PrefixSuggester& Database_Operator::_Suggester(PrefixSuggester::Kind kind){
+    static PrefixSuggester autherSuggester(PrefixSuggester::AUTHER);
+    static PrefixSuggester titleSuggester(PrefixSuggester::TITLE);
+    return kind == PrefixSuggester::AUTHER ? autherSuggester : titleSuggester;
+}
+
+//  全部连接共享的作者模糊索引；
+FuzzyAutherIndex& Database_Operator::_FuzzyIndex(){
+    static FuzzyAutherIndex index;
+    return index;
+}
+
 //  显示全部数据；
 void Database_Operator::ShowAll(){
     _commond_ = "SELECT Year,Auther,Title FROM test ORDER BY Year;";
@@ -202,16 +818,41 @@ void Database_Operator::ShowAll(){
 }
 
 
+//  结束并回收更新线程；
+Catalog_Refresher::~Catalog_Refresher(){
+    _isEnd_.store(true);
+    _mutexEnd_.lock();
+    _conditionEnd_.notify_all();
+    _mutexEnd_.unlock();
+    if( _refreshThread_.joinable() )
+        _refreshThread_.join();
+}
+//  定时更新（首次更新由请求线程完成，此处先等待一个周期）；
+void Catalog_Refresher::_Refresh(){
+    while( true ){
+        {
+            unique_lock<mutex> lock(_mutexEnd_);
+            _conditionEnd_.wait_for(lock , chrono::seconds(FACET_REFRESH) , [this]{ return _isEnd_.load(); });
+        }
+        if( _isEnd_.load() )
+            return;
+        _refresh_();
+    }
+}
+
 //  登记线程池分配任务的对象信息
 ServerTask::ServerTask( const int &cfd , const struct sockaddr_in &ca , map<int,int>* heartCountMap){
     _confd_ = cfd;
     _clientAddr_ = ca;
     _heartCount_ = heartCountMap;
     _heartChar_ = HEARTBEAT;
+    _buf_ = nullptr;
 }
 
 //  执行 线程池 分配的任务；
 void ServerTask::Run(){
+    _buf_ = ThreadWorker::LocalBuffer( MAXLINE + 1 );   //多留一字节保证以 '\0' 结尾；
+    bzero( _buf_ , MAXLINE + 1 );
     while(true){
         if( _Receive() != true)
             break;
@@ -219,56 +860,149 @@ void ServerTask::Run(){
             cout << "SendBack ERROR !!! " << endl;
     }
     close( _confd_ );
+    ClientLimiter::Shared().Disconnect( _clientAddr_.sin_addr.s_addr );
 }
 
-//  发送结果至客户端；
+//  发送结果至客户端（结果可能为二进制且超过 MAXLINE，按实际长度分段发送）；
 bool ServerTask::_Send(){
-    bzero( &_buf_ , sizeof(_buf_) );
-    result.copy(_buf_,result.size(),0);
-    result = "";
-    _sendStatus_ = send(_confd_ , _buf_ , strlen(_buf_) , 0 ); 
-    if( _sendStatus_ <= 0){
-        bzero( &_buf_ , sizeof(_buf_) );
-        return false;
-    }
-    else{
-        bzero( &_buf_ , sizeof(_buf_) );
+    SingleFlight::Response response = _response_;
+    _response_.reset();
+    if( response == nullptr )
         return true;
+    size_t sent = 0u;
+    while( sent < response->size() ){
+        _sendStatus_ = send(_confd_ , response->data() + sent , response->size() - sent , MSG_NOSIGNAL );
+        if( _sendStatus_ <= 0)
+            return false;
+        sent += (size_t)_sendStatus_;
     }
+    return true;
 }
 
-//  对客户端需求进行分析并执行    需求格式：  “查询信息#查询属性”；
+//  对客户端需求进行分析并执行    需求格式：  “查询信息#查询属性[#返回格式]”；
 void ServerTask::_CommondAnalyse(){
     char* buf_ptr = _buf_;
     char* separation_commond = strchr(_buf_,'#');
-    string operatorCode = ( separation_commond + 1);
-    int operatorNum = stoi(operatorCode );
+    if( separation_commond == NULL ){
+        _response_ = make_shared<const string>("WRONG OPTION");
+        return;
+    }
+    char* separation_format = strchr(separation_commond + 1,'#');
+    int operatorNum = atoi( separation_commond + 1 );
+    _format_ = ( separation_format == NULL ) ? FORMAT_TEXT : atoi( separation_format + 1 );
+    if( _format_ < FORMAT_TEXT || _format_ > FORMAT_COLUMNS )
+        _format_ = FORMAT_TEXT;
     string parameter;
     while(buf_ptr != separation_commond){
         parameter += *(buf_ptr ++);
     }
 
-    //  执行具体需求；
+    //  按限流放行、限速或拒绝（拒绝信息按请求的返回格式编码）；
+    long wait = ClientLimiter::Shared().Acquire( _clientAddr_.sin_addr.s_addr );
+    if( wait < 0 ){
+        _Fail( LIMIT_RATEMSG );
+        _response_ = make_shared<const string>( move(result) );
+        result = "";
+        return;
+    }
+    if( wait > 0 )
+        this_thread::sleep_for( chrono::microseconds(wait) );
+
+    //  查询类需求经请求合并执行，其余需求（统计、输入提示）直接执行；
+    if( operatorNum >= OP_SHOWALL && operatorNum <= OP_TOPK && operatorNum != OP_STATS ){
+        bool coalesced;
+        _response_ = _SingleFlight().Do( _FlightKey(operatorNum , _format_ , parameter) ,
+                [this , operatorNum , &parameter]{
+                    _Execute(operatorNum , parameter);
+                    return move(result);
+                } , coalesced );
+    } else {
+        _Execute(operatorNum , parameter);
+        _response_ = make_shared<const string>( move(result) );
+    }
+    result = "";
+}
+
+//  执行具体需求；
+void ServerTask::_Execute(int operatorNum , const string &parameter){
     switch(operatorNum){
-        case 0:{
+        case OP_SHOWALL:{
                    ShowAll();
                    break;
                }
-        case 1:{
+        case OP_YEAR:{
                    SearchByYear(parameter);
                    break;
                }
-        case 2:{
+        case OP_AUTHER:{
                    SearchByAuther(parameter);
                    break;
                }
+        case OP_AUTHERFUZZY:{
+                   SearchByAutherFuzzy(parameter);
+                   break;
+               }
+        case OP_QUERY:{
+                   SearchByQuery(parameter);
+                   break;
+               }
+        case OP_STATS:{
+                   _ShowStats();
+                   break;
+               }
+        case OP_SYNC:{
+                   SyncSince(parameter);
+                   break;
+               }
+        case OP_FACET:{
+                   CountByFacet(parameter);
+                   break;
+               }
+        case OP_TOPK:{
+                   TopByFacet(parameter);
+                   break;
+               }
+        case OP_SUGGEST:{
+                   SuggestByPrefix(parameter);
+                   break;
+               }
         default:{
-                   result = "WRONG OPTION";
+                   _Fail( "WRONG OPTION" );
                    break;
                }
     };
 }
 
+//  服务器统计信息，每行格式：  “名称 数值”；
+void ServerTask::_ShowStats(){
+    SingleFlight &flight = _SingleFlight();
+    result  = "query_executed " + to_string( flight.Executed() ) + "\n";
+    result += "query_coalesced " + to_string( flight.Coalesced() ) + "\n";
+    result += "query_inflight " + to_string( flight.InFlight() ) + "\n";
+    result += "fuzzy_index_authers " + to_string( _FuzzyIndex().Size() ) + "\n";
+    result += "facet_index_documents " + to_string( _Facets().Documents() ) + "\n";
+    result += "facet_index_watermark " + to_string( _Facets().Watermark() ) + "\n";
+    result += "suggest_authers " + to_string( _Suggester(PrefixSuggester::AUTHER).Terms() ) + "\n";
+    result += "suggest_title_words " + to_string( _Suggester(PrefixSuggester::TITLE).Terms() ) + "\n";
+    result += _router_->Describe();
+    result += ClientLimiter::Shared().Describe();
+    result += ThreadPool::DescribeAll();
+}
+
+//  全部连接共享的请求合并表；
+SingleFlight& ServerTask::_SingleFlight(){
+    static SingleFlight flight;
+    return flight;
+}
+
+//  合并键值：请求方法#返回格式#请求内容；
+//  模糊作者的结果只取决于按索引规则规范化后的内容，故以规范化结果为键；
+//  其余命令原样使用请求内容（尾部空白在 NO PAD 排序规则下会改变结果，不能裁剪）；
+string ServerTask::_FlightKey(int operatorNum , int format , const string &parameter){
+    string normalized = ( operatorNum == OP_AUTHERFUZZY ) ? FuzzyAutherIndex::Normalize(parameter) : parameter;
+    return to_string(operatorNum) + "#" + to_string(format) + "#" + normalized;
+}
+
 //  接收客户端请求并执行
 bool ServerTask::_Receive(){
     while(true){
@@ -286,11 +1020,11 @@ bool ServerTask::_Receive(){
         }
         //  若为心跳检测则忽略；
         if( strncmp( _buf_ , _heartChar_ , HEARTBEATSIZE) == 0 ){
-            bzero( &_buf_ , sizeof(_buf_) );
+            bzero( _buf_ , MAXLINE + 1 );
             continue;
-        } else {    //为需求则执行；
-            CommondAnalyse();                   //分析请求并执行；
-            bzero( &_buf_ , sizeof(_buf_) );
+        } else {    //为需求则分析、限流并执行；
+            _CommondAnalyse();
+            bzero( _buf_ , MAXLINE + 1 );
             return true;
         }
     }
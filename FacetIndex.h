@@ -0,0 +1,269 @@
+//*********************************************************************
+//
+//  FacetIndex.h ：
+//      1、定义 文档变更记录                 : struct FacetChange;
+//      2、定义 分面统计的过滤条件           : struct FacetFilter;
+//      3、定义并实现 分面计数索引           : class FacetIndex;
+//
+//  功能特点：
+//      1、以列式数组（年份、作者编号）保存全部文档，作者名经字典编码；
+//      2、无过滤条件时直接返回增量维护的计数器；有过滤条件时对列式数组做一次顺序扫描的分组计数，
+//         过滤条件以无分支的 0/1 累加代替跳转（按键分散写入计数数组，不能向量化，但不受分支预测失败影响）；
+//      3、由全表快照初始化，之后按变更日志（见 sql/ChangeLog.sql）增量更新，不对 MySQL 做 GROUP BY；
+//
+//  制作信息：
+//      韩佩恩  2019 于 上海同济大学；
+//
+//*********************************************************************
+
+#if!defined FACETINDEX_H
+#define FACETINDEX_H
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+#include <unordered_map>
+#include <ctime>
+#include <stdint.h>
+#pragma once
+using namespace std;
+
+#define FACET_MAXYEAR 9999      //年份取值上限（年份计数使用稠密数组）；
+
+//  文档变更记录（快照时 op 为 'S'，各内存索引共用）；
+struct FacetChange{
+    uint64_t seq;
+    char op;            //'I' 新增，'U' 修改，'D' 删除，'S' 快照；
+    int docId;
+    int year;
+    string auther;
+    string title;       //分面索引不使用；
+};
+
+//  分面统计的过滤条件；
+struct FacetFilter{
+    FacetFilter() : yearLow(0),yearHigh(FACET_MAXYEAR){}
+    int yearLow , yearHigh;     //年份闭区间；
+    vector<string> authers;     //限定作者（为空不限）；
+    bool IsEmpty() const { return yearLow <= 0 && yearHigh >= FACET_MAXYEAR && authers.empty(); }
+};
+
+//  分面计数索引
+//  主要功能：1、快照重建与增量更新；2、按年份或作者分组计数（可过滤、可取前 k）；
+class FacetIndex{
+    public:
+        enum Dimension{ YEAR = 0 , AUTHER = 1 };
+        FacetIndex() : _watermark_(0u),_refreshTime_(0),_isLoaded_(false),_isRefreshing_(false){}
+        FacetIndex(const FacetIndex & index) = delete;
+        FacetIndex & operator=(const FacetIndex & index) = delete;
+
+        void Reset(const vector<FacetChange> &snapshot , uint64_t watermark); //由快照重建；
+        void Apply(const vector<FacetChange> &changes);     //按 Seq 顺序应用变更并推进水位；
+        //  分组计数：byCount 为真时按计数降序，否则按取值升序；limit 为返回组数上限；
+        vector<pair<string,size_t> > Count(Dimension dimension , const FacetFilter &filter ,
+                bool byCount , size_t limit);
+        uint64_t Watermark();           //已应用的最大变更序号；
+        size_t Documents();             //文档数；
+        bool IsLoaded();                //是否已由快照初始化；
+        time_t RefreshTime();           //最近一次更新时间；
+        bool TryBeginRefresh();         //抢占更新权，成功者负责调用 EndRefresh；
+        void EndRefresh();
+
+    private:
+        vector<int> _docIds_;           //列：文档编号；
+        vector<int> _years_;            //列：年份；
+        vector<uint32_t> _authers_;     //列：作者编号；
+        unordered_map<int , size_t> _rowOf_;            //文档编号 -> 行号；
+        vector<string> _autherNames_;                   //作者字典；
+        unordered_map<string , uint32_t> _autherIds_;
+        vector<size_t> _yearCounts_;    //增量维护的年份计数；
+        vector<size_t> _autherCounts_;  //增量维护的作者计数；
+        uint64_t _watermark_;
+        time_t _refreshTime_;
+        bool _isLoaded_;
+        mutex _mutex_;
+        atomic<bool> _isRefreshing_;
+
+        void _Upsert(int docId , int year , const string &auther);
+        void _Erase(int docId);
+        uint32_t _AutherId(const string &auther);
+        static int _ClampYear(int year);
+};
+
+
+//----------------------------------------------------------------------//
+//
+//              *******   函数实现   *******
+//
+
+//  由快照重建；
+void FacetIndex::Reset(const vector<FacetChange> &snapshot , uint64_t watermark){
+    lock_guard<mutex> lock(_mutex_);
+    _docIds_.clear();
+    _years_.clear();
+    _authers_.clear();
+    _rowOf_.clear();
+    _autherNames_.clear();
+    _autherIds_.clear();
+    _yearCounts_.assign(FACET_MAXYEAR + 1 , 0u);
+    _autherCounts_.clear();
+    _docIds_.reserve(snapshot.size());
+    _years_.reserve(snapshot.size());
+    _authers_.reserve(snapshot.size());
+    for(auto &change : snapshot)
+        _Upsert(change.docId , change.year , change.auther);
+    _watermark_ = watermark;
+    _refreshTime_ = time(NULL);
+    _isLoaded_ = true;
+}
+
+//  应用变更；
+void FacetIndex::Apply(const vector<FacetChange> &changes){
+    lock_guard<mutex> lock(_mutex_);
+    for(auto &change : changes){
+        if( change.seq <= _watermark_ )
+            continue;
+        if( change.op == 'D' )
+            _Erase(change.docId);
+        else
+            _Upsert(change.docId , change.year , change.auther);
+        _watermark_ = change.seq;
+    }
+    _refreshTime_ = time(NULL);
+}
+
+//  分组计数；
+vector<pair<string,size_t> > FacetIndex::Count(Dimension dimension , const FacetFilter &filter ,
+        bool byCount , size_t limit){
+    vector<pair<string,size_t> > res;
+    lock_guard<mutex> lock(_mutex_);
+    vector<size_t> filtered;
+    const vector<size_t>* counts = ( dimension == YEAR ) ? &_yearCounts_ : &_autherCounts_;
+    if( !filter.IsEmpty() ){
+        //  过滤条件：年份区间与作者集合（作者以编号位图表示）；
+        //  每行无条件累加 0 或 1：读取为顺序访问，写入按键分散（编译器不会向量化），避免了难以预测的分支；
+        int low = max(filter.yearLow , 0) , high = min(filter.yearHigh , FACET_MAXYEAR);
+        vector<uint8_t> autherMask( _autherNames_.size() , filter.authers.empty() ? 1u : 0u );
+        for(auto &auther : filter.authers){
+            auto it = _autherIds_.find(auther);
+            if( it != _autherIds_.end() )
+                autherMask[it->second] = 1u;
+        }
+        filtered.assign( counts->size() , 0u );
+        const int* years = _years_.data();
+        const uint32_t* authers = _authers_.data();
+        const uint8_t* mask = autherMask.data();
+        size_t* out = filtered.data();
+        size_t rows = _years_.size();
+        if( dimension == YEAR ){
+            for(size_t r=0u;r<rows;r++)
+                out[years[r]] += (size_t)( (years[r] >= low) & (years[r] <= high) & mask[authers[r]] );
+        } else {
+            for(size_t r=0u;r<rows;r++)
+                out[authers[r]] += (size_t)( (years[r] >= low) & (years[r] <= high) & mask[authers[r]] );
+        }
+        counts = &filtered;
+    }
+    for(size_t key=0u;key<counts->size();key++){
+        if( (*counts)[key] == 0u )
+            continue;
+        res.push_back( make_pair( dimension == YEAR ? to_string(key) : _autherNames_[key] , (*counts)[key] ) );
+    }
+    if( byCount ){
+        stable_sort(res.begin(),res.end(),[](const pair<string,size_t> &x , const pair<string,size_t> &y){
+                return x.second > y.second; });
+    }
+    if( res.size() > limit )
+        res.resize(limit);
+    return res;
+}
+
+//  已应用的最大变更序号；
+uint64_t FacetIndex::Watermark(){
+    lock_guard<mutex> lock(_mutex_);
+    return _watermark_;
+}
+//  文档数；
+size_t FacetIndex::Documents(){
+    lock_guard<mutex> lock(_mutex_);
+    return _docIds_.size();
+}
+//  是否已初始化；
+bool FacetIndex::IsLoaded(){
+    lock_guard<mutex> lock(_mutex_);
+    return _isLoaded_;
+}
+//  最近一次更新时间；
+time_t FacetIndex::RefreshTime(){
+    lock_guard<mutex> lock(_mutex_);
+    return _refreshTime_;
+}
+//  抢占更新权；
+bool FacetIndex::TryBeginRefresh(){
+    bool expected = false;
+    return _isRefreshing_.compare_exchange_strong(expected , true);
+}
+void FacetIndex::EndRefresh(){
+    _isRefreshing_.store(false);
+}
+
+//  新增或修改文档：先撤销旧值的计数，再计入新值；
+void FacetIndex::_Upsert(int docId , int year , const string &auther){
+    year = _ClampYear(year);
+    uint32_t autherId = _AutherId(auther);
+    auto it = _rowOf_.find(docId);
+    size_t row;
+    if( it == _rowOf_.end() ){
+        row = _docIds_.size();
+        _rowOf_.insert( make_pair(docId , row) );
+        _docIds_.push_back(docId);
+        _years_.push_back(year);
+        _authers_.push_back(autherId);
+    } else {
+        row = it->second;
+        _yearCounts_[ _years_[row] ] --;
+        _autherCounts_[ _authers_[row] ] --;
+        _years_[row] = year;
+        _authers_[row] = autherId;
+    }
+    _yearCounts_[year] ++;
+    _autherCounts_[autherId] ++;
+}
+//  删除文档：以末行填补空位；
+void FacetIndex::_Erase(int docId){
+    auto it = _rowOf_.find(docId);
+    if( it == _rowOf_.end() )
+        return;
+    size_t row = it->second , last = _docIds_.size() - 1u;
+    _yearCounts_[ _years_[row] ] --;
+    _autherCounts_[ _authers_[row] ] --;
+    _rowOf_.erase(it);
+    if( row != last ){
+        _docIds_[row] = _docIds_[last];
+        _years_[row] = _years_[last];
+        _authers_[row] = _authers_[last];
+        _rowOf_[ _docIds_[row] ] = row;
+    }
+    _docIds_.pop_back();
+    _years_.pop_back();
+    _authers_.pop_back();
+}
+//  作者字典编号（新作者追加）；
+uint32_t FacetIndex::_AutherId(const string &auther){
+    auto it = _autherIds_.find(auther);
+    if( it != _autherIds_.end() )
+        return it->second;
+    uint32_t id = (uint32_t)_autherNames_.size();
+    _autherIds_.insert( make_pair(auther , id) );
+    _autherNames_.push_back(auther);
+    _autherCounts_.push_back(0u);
+    return id;
+}
+//  年份限定在稠密数组范围内；
+int FacetIndex::_ClampYear(int year){
+    return year < 0 ? 0 : ( year > FACET_MAXYEAR ? FACET_MAXYEAR : year );
+}
+
+#endif
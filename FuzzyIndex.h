@@ -0,0 +1,314 @@
+//*********************************************************************
+//
+//  FuzzyIndex.h ：
+//      1、定义并实现 作者名模糊检索索引   : class FuzzyAutherIndex;
+//
+//  检索流程：
+//      1、规范化：转小写、去除标点、按词项排序（"G. Hinton" 与 "Hinton G" 等价）；
+//      2、候选：基于三元组（trigram）倒排表，按共享三元组数量取前若干候选；
+//      3、校验：逐词项计算有界编辑距离（Myers 位并行算法），单字母视为首字母缩写；
+//      4、排序：按总编辑距离、未匹配词项数、候选命中数返回前 N 个作者；
+//
+//  制作信息：
+//      韩佩恩  2019 于 上海同济大学；
+//
+//*********************************************************************
+
+#if!defined FUZZYINDEX_H
+#define FUZZYINDEX_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+#include <unordered_map>
+#include <ctime>
+#include <cctype>
+#include <stdint.h>
+#pragma once
+using namespace std;
+
+#define FUZZY_MAXCANDIDATE 256  //进入编辑距离校验的最大候选数；
+
+//  模糊检索结果：原始作者名与其编辑距离；
+struct FuzzyAutherMatch{
+    string auther;      //作者名（与数据库一致）；
+    int distance;       //词项编辑距离之和；
+};
+
+//  作者名模糊检索索引
+//  主要功能：1、由作者名列表整体构建索引；2、并发只读检索；
+//  索引以快照形式保存，重建时整体替换，检索不被重建阻塞；
+class FuzzyAutherIndex{
+    public:
+        FuzzyAutherIndex() : _isBuilding_(false){}
+        FuzzyAutherIndex(const FuzzyAutherIndex & index) = delete;
+        FuzzyAutherIndex & operator=(const FuzzyAutherIndex & index) = delete;
+
+        static string Normalize(const string &name);   //规范化作者名；
+        static int EditDistance(const string &a , const string &b , int bound);//有界编辑距离；
+
+        void Build(const vector<string> &authers);      //构建索引（整体替换）；
+        vector<FuzzyAutherMatch> Search(const string &query , size_t topN);//模糊检索；
+        bool TryBeginBuild();       //抢占重建权，成功者负责调用 Build 或 AbortBuild；
+        void AbortBuild();          //放弃重建；
+        size_t Size();              //索引中的作者数量；
+        time_t BuildTime();         //最近一次构建时间（未构建为0）；
+
+    private:
+        struct _Entry_{
+            string raw;             //原始作者名；
+            vector<string> tokens;  //规范化后的词项；
+        };
+        struct _Snapshot_{
+            vector<_Entry_> entries;
+            unordered_map<uint32_t , vector<uint32_t> > trigrams;  //三元组 -> 作者编号表；
+            time_t buildTime;
+        };
+        shared_ptr<const _Snapshot_> _snapshot_;
+        mutex _mutexSnapshot_;
+        atomic<bool> _isBuilding_;
+
+        shared_ptr<const _Snapshot_> _Current();
+        static vector<string> _Tokenize(const string &normalized);
+        static void _Trigrams(const string &token , vector<uint32_t> &out);
+        static int _TokenLimit(const string &token);
+        static int _MyersDistance(const string &pattern , const string &text);
+};
+
+
+//----------------------------------------------------------------------//
+//
+//              *******   函数实现   *******
+//
+
+//  规范化：ASCII 转小写，标点视为分隔符，词项按字典序排序后以空格连接；
+string FuzzyAutherIndex::Normalize(const string &name){
+    vector<string> tokens;
+    string token;
+    for(size_t i=0u;i<name.size();i++){
+        unsigned char c = (unsigned char)name[i];
+        if( c >= 0x80 || isalnum(c) ){
+            token += (char)( c < 0x80 ? tolower(c) : c );
+        } else if( !token.empty() ){
+            tokens.push_back(token);
+            token.clear();
+        }
+    }
+    if( !token.empty() )
+        tokens.push_back(token);
+    sort(tokens.begin(),tokens.end());
+    string res;
+    for(size_t i=0u;i<tokens.size();i++){
+        if( i != 0u ) res += ' ';
+        res += tokens[i];
+    }
+    return res;
+}
+
+//  有界编辑距离：超出 bound 时返回 bound+1；
+int FuzzyAutherIndex::EditDistance(const string &a , const string &b , int bound){
+    int diff = (int)a.size() - (int)b.size();
+    if( diff < 0 ) diff = -diff;
+    if( diff > bound )
+        return bound + 1;
+    int dist = _MyersDistance(a,b);
+    return dist > bound ? bound + 1 : dist;
+}
+
+//  构建索引：生成新快照后整体替换；
+void FuzzyAutherIndex::Build(const vector<string> &authers){
+    shared_ptr<_Snapshot_> snap(new _Snapshot_());
+    snap->entries.reserve(authers.size());
+    vector<uint32_t> grams;
+    for(size_t i=0u;i<authers.size();i++){
+        _Entry_ entry;
+        entry.raw = authers[i];
+        entry.tokens = _Tokenize( Normalize(authers[i]) );
+        if( entry.tokens.empty() )
+            continue;
+        uint32_t id = (uint32_t)snap->entries.size();
+        grams.clear();
+        for(auto &token : entry.tokens)
+            _Trigrams(token , grams);
+        sort(grams.begin(),grams.end());
+        grams.erase( unique(grams.begin(),grams.end()) , grams.end() );
+        for(auto gram : grams)
+            snap->trigrams[gram].push_back(id);
+        snap->entries.push_back(move(entry));
+    }
+    snap->buildTime = time(NULL);
+    _mutexSnapshot_.lock();
+    _snapshot_ = snap;
+    _mutexSnapshot_.unlock();
+    _isBuilding_.store(false);
+}
+
+//  模糊检索：三元组取候选，逐词项有界编辑距离校验后排序；
+vector<FuzzyAutherMatch> FuzzyAutherIndex::Search(const string &query , size_t topN){
+    vector<FuzzyAutherMatch> res;
+    shared_ptr<const _Snapshot_> snap = _Current();
+    vector<string> qTokens = _Tokenize( Normalize(query) );
+    if( snap == nullptr || qTokens.empty() || topN == 0u )
+        return res;
+
+    //  统计候选作者共享的三元组数量；
+    vector<uint32_t> grams;
+    for(auto &token : qTokens)
+        _Trigrams(token , grams);
+    sort(grams.begin(),grams.end());
+    grams.erase( unique(grams.begin(),grams.end()) , grams.end() );
+    unordered_map<uint32_t , uint32_t> hits;
+    for(auto gram : grams){
+        auto it = snap->trigrams.find(gram);
+        if( it == snap->trigrams.end() )
+            continue;
+        for(auto id : it->second)
+            hits[id] ++;
+    }
+    vector<pair<uint32_t,uint32_t> > candidates(hits.begin(),hits.end());   //(编号,命中数)；
+    sort(candidates.begin(),candidates.end(),
+            [](const pair<uint32_t,uint32_t> &x , const pair<uint32_t,uint32_t> &y){
+                return x.second != y.second ? x.second > y.second : x.first < y.first; });
+    if( candidates.size() > FUZZY_MAXCANDIDATE )
+        candidates.resize(FUZZY_MAXCANDIDATE);
+
+    //  逐词项校验：每个查询词项取候选中距离最小的词项，单字母按首字母匹配；
+    struct Ranked{ uint32_t id; int distance; int unmatched; uint32_t hits; };
+    vector<Ranked> ranked;
+    for(auto &cand : candidates){
+        const _Entry_ &entry = snap->entries[cand.first];
+        int total = 0;
+        bool accept = true;
+        for(auto &qt : qTokens){
+            int limit = _TokenLimit(qt);
+            int best = limit + 1;
+            for(auto &ct : entry.tokens){
+                int dist;
+                if( qt.size() == 1u )
+                    dist = ( ct[0] == qt[0] ) ? 0 : limit + 1;
+                else
+                    dist = EditDistance(qt , ct , limit);
+                if( dist < best ) best = dist;
+                if( best == 0 ) break;
+            }
+            if( best > limit ){
+                accept = false;
+                break;
+            }
+            total += best;
+        }
+        if( !accept )
+            continue;
+        int unmatched = (int)entry.tokens.size() - (int)qTokens.size();
+        ranked.push_back( Ranked{ cand.first , total , unmatched < 0 ? 0 : unmatched , cand.second } );
+    }
+    sort(ranked.begin(),ranked.end(),[](const Ranked &x , const Ranked &y){
+            if( x.distance != y.distance ) return x.distance < y.distance;
+            if( x.unmatched != y.unmatched ) return x.unmatched < y.unmatched;
+            if( x.hits != y.hits ) return x.hits > y.hits;
+            return x.id < y.id; });
+    for(size_t i=0u;i<ranked.size() && res.size()<topN;i++)
+        res.push_back( FuzzyAutherMatch{ snap->entries[ranked[i].id].raw , ranked[i].distance } );
+    return res;
+}
+
+//  抢占重建权（同一时刻仅一个线程访问数据库重建索引）；
+bool FuzzyAutherIndex::TryBeginBuild(){
+    bool expected = false;
+    return _isBuilding_.compare_exchange_strong(expected , true);
+}
+void FuzzyAutherIndex::AbortBuild(){
+    _isBuilding_.store(false);
+}
+//  返回索引规模；
+size_t FuzzyAutherIndex::Size(){
+    shared_ptr<const _Snapshot_> snap = _Current();
+    return snap == nullptr ? 0u : snap->entries.size();
+}
+//  返回最近构建时间；
+time_t FuzzyAutherIndex::BuildTime(){
+    shared_ptr<const _Snapshot_> snap = _Current();
+    return snap == nullptr ? 0 : snap->buildTime;
+}
+//  取得当前快照；
+shared_ptr<const FuzzyAutherIndex::_Snapshot_> FuzzyAutherIndex::_Current(){
+    _mutexSnapshot_.lock();
+    shared_ptr<const _Snapshot_> snap = _snapshot_;
+    _mutexSnapshot_.unlock();
+    return snap;
+}
+//  按空格切分规范化后的作者名；
+vector<string> FuzzyAutherIndex::_Tokenize(const string &normalized){
+    vector<string> tokens;
+    size_t begin = 0u;
+    while( begin < normalized.size() ){
+        size_t end = normalized.find(' ',begin);
+        if( end == string::npos ) end = normalized.size();
+        if( end > begin )
+            tokens.push_back( normalized.substr(begin , end - begin) );
+        begin = end + 1u;
+    }
+    return tokens;
+}
+//  生成词项三元组（两端以 '$' 填充，单字母词项仅生成首字母三元组）；
+void FuzzyAutherIndex::_Trigrams(const string &token , vector<uint32_t> &out){
+    string padded = "$" + token + "$";
+    if( token.size() == 1u ){
+        out.push_back( ((uint32_t)'$' << 16) | ((uint32_t)(unsigned char)token[0] << 8) );
+        return;
+    }
+    for(size_t i=0u;i+2u<padded.size();i++)
+        out.push_back( ((uint32_t)(unsigned char)padded[i] << 16) |
+                ((uint32_t)(unsigned char)padded[i+1] << 8) | (uint32_t)(unsigned char)padded[i+2] );
+}
+//  单个词项允许的最大编辑距离；
+int FuzzyAutherIndex::_TokenLimit(const string &token){
+    if( token.size() <= 2u ) return 0;
+    if( token.size() <= 4u ) return 1;
+    if( token.size() <= 8u ) return 2;
+    return 3;
+}
+//  Myers 位并行编辑距离（模式长度不超过64，否则退化为动态规划）；
+int FuzzyAutherIndex::_MyersDistance(const string &pattern , const string &text){
+    size_t m = pattern.size();
+    if( m == 0u ) return (int)text.size();
+    if( text.empty() ) return (int)m;
+    if( m > 64u ){
+        vector<int> dp(text.size() + 1u);
+        for(size_t j=0u;j<=text.size();j++) dp[j] = (int)j;
+        for(size_t i=1u;i<=m;i++){
+            int diag = dp[0];
+            dp[0] = (int)i;
+            for(size_t j=1u;j<=text.size();j++){
+                int up = dp[j];
+                dp[j] = min( min(dp[j] + 1 , dp[j-1] + 1) , diag + (pattern[i-1] != text[j-1]) );
+                diag = up;
+            }
+        }
+        return dp[text.size()];
+    }
+    uint64_t peq[256] = {0};
+    for(size_t i=0u;i<m;i++)
+        peq[(unsigned char)pattern[i]] |= (uint64_t)1 << i;
+    uint64_t pv = ~(uint64_t)0 , mv = 0 , high = (uint64_t)1 << (m - 1u);
+    int score = (int)m;
+    for(size_t j=0u;j<text.size();j++){
+        uint64_t eq = peq[(unsigned char)text[j]];
+        uint64_t xv = eq | mv;
+        uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+        uint64_t ph = mv | ~(xh | pv);
+        uint64_t mh = pv & xh;
+        if( ph & high ) score ++;
+        else if( mh & high ) score --;
+        ph = (ph << 1) | 1u;
+        mh <<= 1;
+        pv = mh | ~(xv | ph);
+        mv = ph & xv;
+    }
+    return score;
+}
+
+#endif
@@ -0,0 +1,246 @@
+//*********************************************************************
+//
+//  MySQLRouter.h ：
+//      1、定义 MySQL 后端信息               : struct MySQL_Backend;
+//      2、定义并实现 多后端的读写路由       : class MySQL_Router;
+//
+//  功能特点：
+//      1、后端列表由配置文件读取（路径取环境变量 DDB_BACKENDS，缺省为 ROUTER_CONFIG），
+//         每行格式：  “primary|replica  主机  端口  用户名  密码  数据库”，'#' 起为注释；
+//         无配置文件时使用本文件中定义的登陆信息作为单一主库；
+//      2、后台线程定时检测各后端（连接并 ping），并以 EWMA 记录请求延迟；
+//      3、读请求优先发往延迟最低的健康从库，其次主库，最后尝试异常后端；写请求只发往主库；
+//
+//  制作信息：
+//      韩佩恩  2019 于 上海同济大学；
+//
+//*********************************************************************
+
+#if!defined MYSQLROUTER_H
+#define MYSQLROUTER_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <condition_variable>
+#include <stdlib.h>
+#include "mysql.h"
+#pragma once
+using namespace std;
+
+//定义 MySQL 的登陆信息（无配置文件时作为唯一主库）；
+#define USERNAME    "***"
+#define PASSWORD    "***"
+#define HOST        "***"
+#define TABLE       "***"
+#define MYSQLPORT   3306
+
+#define ROUTER_CONFIG           "ddb_backends.conf" //缺省配置文件；
+#define ROUTER_CHECKINTERVAL    5       //健康检测间隔（秒）；
+#define ROUTER_CONNECTTIMEOUT   2       //连接超时（秒）；
+#define ROUTER_EWMAALPHA        0.2     //EWMA 平滑系数；
+
+//  MySQL 后端信息；
+struct MySQL_Backend{
+    MySQL_Backend(const string &host , unsigned int port , const string &user ,
+            const string &pswd , const string &database , bool isPrimary)
+        : host(host),port(port),user(user),pswd(pswd),database(database),isPrimary(isPrimary),
+          isHealthy(true),ewmaMs(-1.0),requests(0u),failures(0u){}
+    string host;
+    unsigned int port;
+    string user , pswd , database;
+    bool isPrimary;             //是否为主库（唯一可写）；
+    atomic<bool> isHealthy;     //最近一次访问或检测是否成功；
+    atomic<double> ewmaMs;      //延迟的指数加权平均（毫秒，无样本为负）；
+    atomic<size_t> requests , failures; //请求数、失败数；
+};
+
+//  多后端的读写路由
+//  主要功能：1、读取后端配置；2、按健康状态与延迟选取后端；3、后台健康检测；
+class MySQL_Router{
+    public:
+        MySQL_Router() : _isEnd_(false){}
+        ~MySQL_Router();
+        MySQL_Router(const MySQL_Router & router) = delete;
+        MySQL_Router & operator=(const MySQL_Router & router) = delete;
+
+        static MySQL_Router& Shared();  //全部连接共享的路由（首次使用时读取配置并开始检测）；
+        bool Load(const string &path);  //读取配置文件，返回是否读到后端；
+        void AddBackend(const string &host , unsigned int port , const string &user ,
+                const string &pswd , const string &database , bool isPrimary);
+        vector<MySQL_Backend*> Route(bool isWrite);     //按优先顺序返回候选后端；
+        void Report(MySQL_Backend* backend , bool isHealthy , double ms);  //记录一次访问结果；
+        void StartHealthCheck(int interval);            //开始后台健康检测；
+        string Describe();              //各后端状态，每行：  “backend 主机:端口 角色 健康 延迟 请求数/失败数”；
+
+    private:
+        vector<unique_ptr<MySQL_Backend> > _backends_;  //开始检测后不再变动；
+        thread _healthThread_;
+        atomic<bool> _isEnd_;
+        mutex _mutexEnd_;
+        condition_variable _conditionEnd_;
+
+        void _HealthCheck(int interval);
+        bool _Ping(MySQL_Backend* backend , double &ms);
+};
+
+
+//----------------------------------------------------------------------//
+//
+//              *******   函数实现   *******
+//
+
+//  停止健康检测；
+MySQL_Router::~MySQL_Router(){
+    _isEnd_.store(true);
+    _mutexEnd_.lock();
+    _conditionEnd_.notify_all();
+    _mutexEnd_.unlock();
+    if( _healthThread_.joinable() )
+        _healthThread_.join();
+}
+
+//  读取配置文件；
+bool MySQL_Router::Load(const string &path){
+    ifstream file(path);
+    if( !file.is_open() )
+        return false;
+    string line;
+    size_t counts = 0u;
+    while( getline(file , line) ){
+        size_t comment = line.find('#');
+        if( comment != string::npos )
+            line.erase(comment);
+        stringstream stream(line);
+        string role , host , user , pswd , database;
+        unsigned int port;
+        if( !(stream >> role) )
+            continue;
+        if( !(stream >> host >> port >> user >> pswd >> database) || (role != "primary" && role != "replica") ){
+            cout << "ERROR !\n\tMySQL_Router: bad backend line: " << line << endl;
+            continue;
+        }
+        AddBackend(host , port , user , pswd , database , role == "primary");
+        counts ++;
+    }
+    return counts != 0u;
+}
+
+//  添加后端；
+void MySQL_Router::AddBackend(const string &host , unsigned int port , const string &user ,
+        const string &pswd , const string &database , bool isPrimary){
+    _backends_.push_back( unique_ptr<MySQL_Backend>(
+                new MySQL_Backend(host , port , user , pswd , database , isPrimary) ) );
+}
+
+//  按优先顺序返回候选后端；
+//  写：主库；读：健康从库（延迟升序）-> 健康主库 -> 异常从库 -> 异常主库；
+//  健康状态与延迟随时被其它线程更新，先取一次快照再排序，保证比较关系在排序期间不变；
+vector<MySQL_Backend*> MySQL_Router::Route(bool isWrite){
+    struct Candidate{
+        bool isHealthy , isPrimary;
+        double ewmaMs;
+        MySQL_Backend* backend;
+    };
+    vector<Candidate> candidates;
+    for(auto &backend : _backends_)
+        if( !isWrite || backend->isPrimary )
+            candidates.push_back( Candidate{ backend->isHealthy.load() , backend->isPrimary ,
+                    backend->ewmaMs.load() , backend.get() } );
+    stable_sort(candidates.begin(),candidates.end(),[](const Candidate &x , const Candidate &y){
+            if( x.isHealthy != y.isHealthy ) return x.isHealthy;
+            if( x.isPrimary != y.isPrimary ) return !x.isPrimary;
+            return x.ewmaMs < y.ewmaMs; });
+    vector<MySQL_Backend*> res;
+    for(auto &candidate : candidates)
+        res.push_back(candidate.backend);
+    return res;
+}
+
+//  记录一次访问结果并更新 EWMA；
+void MySQL_Router::Report(MySQL_Backend* backend , bool isHealthy , double ms){
+    if( backend == nullptr )
+        return;
+    backend->requests ++;
+    if( !isHealthy ){
+        backend->failures ++;
+        backend->isHealthy.store(false);
+        return;
+    }
+    backend->isHealthy.store(true);
+    double ewma = backend->ewmaMs.load();
+    backend->ewmaMs.store( ewma < 0 ? ms : ROUTER_EWMAALPHA * ms + (1.0 - ROUTER_EWMAALPHA) * ewma );
+}
+
+//  全部连接共享的路由；
+MySQL_Router& MySQL_Router::Shared(){
+    static MySQL_Router router;
+    static once_flag flag;
+    call_once(flag , []{
+        const char* path = getenv("DDB_BACKENDS");
+        if( !router.Load( path == nullptr ? ROUTER_CONFIG : path ) )
+            router.AddBackend(HOST , MYSQLPORT , USERNAME , PASSWORD , TABLE , true);
+        router.StartHealthCheck(ROUTER_CHECKINTERVAL);
+    });
+    return router;
+}
+
+//  开始后台健康检测；
+void MySQL_Router::StartHealthCheck(int interval){
+    if( !_healthThread_.joinable() )
+        _healthThread_ = thread(&MySQL_Router::_HealthCheck , this , interval);
+}
+
+//  各后端状态；
+string MySQL_Router::Describe(){
+    string res;
+    for(auto &backend : _backends_){
+        res += "backend " + backend->host + ":" + to_string(backend->port) +
+            ( backend->isPrimary ? " primary " : " replica " ) +
+            ( backend->isHealthy.load() ? "healthy " : "down " ) +
+            to_string( backend->ewmaMs.load() ) + "ms " +
+            to_string( backend->requests.load() ) + "/" + to_string( backend->failures.load() ) + "\n";
+    }
+    return res;
+}
+
+//  定时检测全部后端；
+void MySQL_Router::_HealthCheck(int interval){
+    while( !_isEnd_.load() ){
+        for(auto &backend : _backends_){
+            double ms = 0.0;
+            bool isHealthy = _Ping(backend.get() , ms);
+            if( isHealthy != backend->isHealthy.load() )
+                cout << "MySQL_Router: " << backend->host << ":" << backend->port
+                    << ( isHealthy ? " is up" : " is down" ) << endl;
+            Report(backend.get() , isHealthy , ms);
+        }
+        unique_lock<mutex> lock(_mutexEnd_);
+        _conditionEnd_.wait_for(lock , chrono::seconds(interval) , [this]{ return _isEnd_.load(); });
+    }
+}
+
+//  连接并 ping 一个后端，ms 返回耗时；
+bool MySQL_Router::_Ping(MySQL_Backend* backend , double &ms){
+    MYSQL con;
+    unsigned int timeout = ROUTER_CONNECTTIMEOUT;
+    auto start = chrono::steady_clock::now();
+    mysql_init(&con);
+    mysql_options(&con , MYSQL_OPT_CONNECT_TIMEOUT , &timeout);
+    bool isHealthy = mysql_real_connect(&con , backend->host.c_str() , backend->user.c_str() ,
+            backend->pswd.c_str() , backend->database.c_str() , backend->port , NULL , 0) != NULL &&
+        mysql_ping(&con) == 0;
+    mysql_close(&con);
+    ms = chrono::duration<double , milli>( chrono::steady_clock::now() - start ).count();
+    return isHealthy;
+}
+
+#endif
@@ -0,0 +1,276 @@
+//*********************************************************************
+//
+//  QueryPlanner.h ：
+//      1、定义 结构化查询的执行计划       : struct QueryPlan;
+//      2、定义并实现 结构化查询解析与规划 : class QueryPlanner;
+//
+//  查询格式（谓词以 ';' 分隔，全部谓词取合取）：
+//      year=2012  year>=2010  year<2015  year=2010-2015    年份（可组合为区间）；
+//      auther=Geoffrey Hinton                               作者精确匹配（可多次出现取交）；
+//      auther~hintn g                                       作者模糊匹配（由作者模糊索引解析，至多一次）；
+//      title~learning                                       标题子串（可多次出现）；
+//      order=year | -year | auther | title                  排序（'-' 表示降序）；
+//      limit=20                                             返回条数上限（缺省不限；超过 QUERY_MAXLIMIT 时报错，不截断）；
+//      例如： “year>=2010;year<=2015;title~network;limit=20#4”
+//
+//  规划策略：
+//      1、年份谓词合并为闭区间，区间为空或作者交集为空时不访问数据库；
+//      2、年份谓词合并为单个 “=” 或 “BETWEEN”，便于 MySQL 使用 Year 上的索引（谓词顺序不影响 MySQL 的执行计划）；
+//      3、排序与条数上限下推至 MySQL，由服务器端完成；未给出 limit 时返回全部结果，不做隐式截断；
+//
+//  制作信息：
+//      韩佩恩  2019 于 上海同济大学；
+//
+//*********************************************************************
+
+#if!defined QUERYPLANNER_H
+#define QUERYPLANNER_H
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+#include <cctype>
+#pragma once
+using namespace std;
+
+#define QUERY_MAXLIMIT  1000    //结构化查询 limit 的最大值；
+#define QUERY_NOLIMIT   ((size_t)-1)    //未给出 limit 时不限条数；
+
+//  结构化查询的执行计划；
+struct QueryPlan{
+    QueryPlan() : yearLow(0),yearHigh(9999),autherFuzzy(false),
+        orderBy("Year"),orderDesc(false),limit(QUERY_NOLIMIT),isEmpty(false){}
+    int yearLow , yearHigh;     //年份闭区间；
+    vector<string> authers;     //作者（精确匹配，取其一即可；模糊匹配解析后亦存于此）；
+    bool autherFuzzy;           //作者是否需经模糊索引解析；
+    string autherText;          //待模糊解析的作者文本；
+    vector<string> titleWords;  //标题子串（合取）；
+    string orderBy;             //排序列；
+    bool orderDesc;             //是否降序；
+    size_t limit;               //返回条数上限（QUERY_NOLIMIT 为不限）；
+    bool isEmpty;               //谓词矛盾，结果必为空；
+};
+
+//  结构化查询解析与规划
+//  主要功能：1、解析客户端查询串为执行计划；2、由执行计划生成下推至 MySQL 的语句；
+class QueryPlanner{
+    public:
+        static bool Parse(const string &parameter , QueryPlan &plan , string &error ,
+                bool needPredicate = true , size_t maxLimit = QUERY_MAXLIMIT);
+                //解析查询串（needPredicate 为假时允许无谓词，limit 超过 maxLimit 时报错）；
+        static string BuildSQL(const QueryPlan &plan);      //生成 SQL；
+        static string Escape(const string &str);            //转义SQL字符串常量；
+        static string EscapeLike(const string &str);        //转义 LIKE 模式中的通配符；
+
+    private:
+        static string _Trim(const string &str);
+        static bool _ParseYear(const string &str , int &year);
+};
+
+
+//----------------------------------------------------------------------//
+//
+//              *******   函数实现   *******
+//
+
+//  解析查询串，失败时 error 给出原因；
+bool QueryPlanner::Parse(const string &parameter , QueryPlan &plan , string &error ,
+        bool needPredicate , size_t maxLimit){
+    size_t begin = 0u;
+    bool hasPredicate = false;
+    while( begin <= parameter.size() ){
+        size_t end = parameter.find(';',begin);
+        if( end == string::npos ) end = parameter.size();
+        string item = _Trim( parameter.substr(begin , end - begin) );
+        begin = end + 1u;
+        if( item.empty() )
+            continue;
+
+        size_t opPos = item.find_first_of("=<>~");
+        if( opPos == string::npos || opPos == 0u ){
+            error = "bad predicate: " + item;
+            return false;
+        }
+        string key = _Trim( item.substr(0,opPos) );
+        string op( 1 , item[opPos] );
+        if( opPos + 1u < item.size() && item[opPos+1] == '=' && op != "=" )
+            op += '=';
+        string value = _Trim( item.substr(opPos + op.size()) );
+        for(auto &c : key) c = tolower(c);
+        if( value.empty() ){
+            error = "empty value: " + item;
+            return false;
+        }
+
+        if( key == "year" ){
+            int low , high;
+            size_t dash = value.find('-');
+            if( op == "=" && dash != string::npos && dash != 0u ){
+                if( !_ParseYear(value.substr(0,dash),low) || !_ParseYear(value.substr(dash+1),high) ){
+                    error = "bad year range: " + value;
+                    return false;
+                }
+            } else {
+                int year;
+                if( !_ParseYear(value,year) ){
+                    error = "bad year: " + value;
+                    return false;
+                }
+                low = 0;
+                high = 9999;
+                if( op == "=" )       { low = year; high = year; }
+                else if( op == ">=" ) { low = year; }
+                else if( op == ">" )  { low = year + 1; }
+                else if( op == "<=" ) { high = year; }
+                else if( op == "<" )  { high = year - 1; }
+                else {
+                    error = "bad year operator: " + op;
+                    return false;
+                }
+            }
+            plan.yearLow = max(plan.yearLow , low);
+            plan.yearHigh = min(plan.yearHigh , high);
+            hasPredicate = true;
+        } else if( key == "auther" ){
+            if( op == "=" ){
+                //  多个精确作者取交：不同则必为空；
+                if( !plan.authers.empty() && plan.authers[0] != value )
+                    plan.isEmpty = true;
+                plan.authers.assign(1 , value);
+            } else if( op == "~" ){
+                //  模糊作者各自解析为一组作者，多次出现的合取没有明确含义，直接报错而不是只保留最后一个；
+                if( plan.autherFuzzy ){
+                    error = "repeated auther~: " + value;
+                    return false;
+                }
+                plan.autherFuzzy = true;
+                plan.autherText = value;
+            } else {
+                error = "bad auther operator: " + op;
+                return false;
+            }
+            hasPredicate = true;
+        } else if( key == "title" ){
+            if( op != "~" ){
+                error = "bad title operator: " + op;
+                return false;
+            }
+            plan.titleWords.push_back(value);
+            hasPredicate = true;
+        } else if( key == "order" ){
+            string column = value;
+            plan.orderDesc = ( column[0] == '-' );
+            if( plan.orderDesc ) column = column.substr(1);
+            for(auto &c : column) c = tolower(c);
+            if( column == "year" )        plan.orderBy = "Year";
+            else if( column == "auther" ) plan.orderBy = "Auther";
+            else if( column == "title" )  plan.orderBy = "Title";
+            else {
+                error = "bad order: " + value;
+                return false;
+            }
+        } else if( key == "limit" ){
+            char* endPtr = nullptr;
+            long limit = strtol(value.c_str() , &endPtr , 10);
+            if( *endPtr != '\0' || limit <= 0 ){
+                error = "bad limit: " + value;
+                return false;
+            }
+            if( (unsigned long)limit > maxLimit ){
+                error = "limit exceeds " + to_string(maxLimit) + ": " + value;
+                return false;
+            }
+            plan.limit = (size_t)limit;
+        } else {
+            error = "unknown key: " + key;
+            return false;
+        }
+    }
+    if( !hasPredicate && needPredicate ){
+        error = "no predicate";
+        return false;
+    }
+    if( plan.yearLow > plan.yearHigh )
+        plan.isEmpty = true;
+    return true;
+}
+
+//  生成 SQL：作者、年份、标题谓词取合取，排序与条数上限一并下推；
+string QueryPlanner::BuildSQL(const QueryPlan &plan){
+    vector<string> predicates;
+    if( !plan.authers.empty() ){
+        string names;
+        for(size_t i=0u;i<plan.authers.size();i++)
+            names += ( i == 0u ? "'" : ",'" ) + Escape(plan.authers[i]) + "'";
+        predicates.push_back( plan.authers.size() == 1u ? "Auther=" + names : "Auther IN (" + names + ")" );
+    }
+    if( plan.yearLow == plan.yearHigh )
+        predicates.push_back( "Year=" + to_string(plan.yearLow) );
+    else if( plan.yearLow != 0 || plan.yearHigh != 9999 )
+        predicates.push_back( "Year BETWEEN " + to_string(plan.yearLow) + " AND " + to_string(plan.yearHigh) );
+    for(auto &word : plan.titleWords)
+        predicates.push_back( "Title LIKE '%" + EscapeLike(word) + "%'" );
+
+    string sql = "SELECT Year,Auther,Title FROM test";
+    for(size_t i=0u;i<predicates.size();i++)
+        sql += ( i == 0u ? " WHERE " : " AND " ) + predicates[i];
+    sql += " ORDER BY " + plan.orderBy + ( plan.orderDesc ? " DESC" : "" );
+    if( plan.orderBy != "Year" )
+        sql += ",Year";
+    if( plan.limit != QUERY_NOLIMIT )
+        sql += " LIMIT " + to_string(plan.limit);
+    sql += ";";
+    return sql;
+}
+
+//  转义SQL字符串常量中的特殊字符；
+string QueryPlanner::Escape(const string &str){
+    string res;
+    res.reserve(str.size());
+    for(auto c : str){
+        switch(c){
+            case '\0':   res += "\\0";  break;
+            case '\n':   res += "\\n";  break;
+            case '\r':   res += "\\r";  break;
+            case '\032': res += "\\Z";  break;
+            case '\\':   res += "\\\\"; break;
+            case '\'':   res += "\\'";  break;
+            case '"':    res += "\\\""; break;
+            default:     res += c;      break;
+        }
+    }
+    return res;
+}
+//  转义 LIKE 模式（通配符 % 与 _ 按字面匹配）；
+string QueryPlanner::EscapeLike(const string &str){
+    string res = Escape(str) , out;
+    out.reserve(res.size());
+    for(auto c : res){
+        if( c == '%' || c == '_' )
+            out += '\\';
+        out += c;
+    }
+    return out;
+}
+//  去除首尾空白；
+string QueryPlanner::_Trim(const string &str){
+    size_t begin = str.find_first_not_of(" \t\r\n");
+    if( begin == string::npos )
+        return "";
+    size_t end = str.find_last_not_of(" \t\r\n");
+    return str.substr(begin , end - begin + 1u);
+}
+//  解析四位以内的非负年份；
+bool QueryPlanner::_ParseYear(const string &str , int &year){
+    string value = _Trim(str);
+    if( value.empty() || value.size() > 4u )
+        return false;
+    for(auto c : value)
+        if( !isdigit((unsigned char)c) )
+            return false;
+    year = atoi(value.c_str());
+    return true;
+}
+
+#endif
@@ -0,0 +1,312 @@
+//*********************************************************************
+//
+//  RowEncoder.h ：
+//      1、定义并实现 查询结果的二进制编码器 : class RowEncoder;
+//
+//  编码格式（整数均为 varint，小端 7 位分组）：
+//      头部：  'D' 'B' 版本(1字节) 布局(1字节，0=按行 1=按列块 2=错误) 总长度(4字节小端，含头部)
+//              字段数  { 字段名长度 字段名 是否字典编码(1字节) } × 字段数
+//              行数  各行（或各列块）
+//              尾部项数  { 名称长度 名称 取值长度 取值 } × 尾部项数（如增量同步的新水位）
+//      错误：  头部之后仅有  信息长度 信息（无字段、行与尾部）；
+//      按行：  每行依次写出各字段值；
+//      按列块：每块先写块内行数，再按列依次写出块内各行的该字段值；
+//      字段值：普通字段  0=NULL，否则 长度+1 后接原始字节；
+//              字典字段  0=NULL，1=新词条（后接 长度 与 原始字节，按出现顺序编号），
+//                        k+2=引用第 k 个词条；
+//
+//  功能特点：
+//      1、按 mysql_num_rows 与字段最大长度预留输出缓冲；每个字段的前缀（varint 等）先写入栈上小缓冲，
+//         与字段内容各以一次 append 写出；
+//      2、字典字段的词条复制到编码器自有的连续缓冲中（开放寻址表，按 8 字节分组散列），
+//         比较时不回读分散在结果集各行中的内存；词条表在多次编码间复用，Begin 不重新分配；
+//
+//  制作信息：
+//      韩佩恩  2019 于 上海同济大学；
+//
+//*********************************************************************
+
+#if!defined ROWENCODER_H
+#define ROWENCODER_H
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <string.h>
+#include <stdint.h>
+#pragma once
+using namespace std;
+
+#define ROWENCODER_VERSION   1    //编码格式版本；
+#define ROWENCODER_BLOCKROWS 256    //按列块布局时每块的行数；
+
+//  查询结果的二进制编码器
+//  使用方法：Begin() 写入头部 -> 逐行 AddRow() -> Finish() 写出尾部并补全长度；
+class RowEncoder{
+    public:
+        enum Layout{ ROWS = 0 , COLUMNS = 1 , ERROR = 2 };
+        RowEncoder() : _out_(nullptr),_layout_(ROWS),_fieldNum_(0u),_lengthPos_(0u){}
+
+        //  开始编码：写入头部并按 sizeHint 预留输出空间；
+        void Begin(string &out , Layout layout , const vector<string> &fieldNames ,
+                const vector<bool> &dictionary , uint64_t rowCount , size_t sizeHint);
+        void AddRow(const char* const* row , const unsigned long* lengths);//编码一行；
+        void Finish(const vector<pair<string,string> > &trailer =
+                vector<pair<string,string> >());     //写出剩余列块与尾部，补全总长度；
+
+        static void PutVarint(string &out , uint64_t value);   //写入 varint；
+        static void EncodeError(string &out , const string &message);  //编码错误信息（布局为 ERROR）；
+        static void AppendText(string &out , const char* const* row ,
+                const unsigned long* lengths , size_t fieldNum);    //以文本格式（" | " 分隔）追加一行；
+
+    private:
+        //  字典词条表：开放寻址，容量为 2 的幂；以代数标记失效，清空为 O(1)；
+        struct _Entry_{
+            size_t offset;              //词条在 keys 中的位置；
+            unsigned long length;
+            uint64_t hash;
+            uint64_t id;
+            uint32_t generation;
+        };
+        struct _Dict_{
+            _Dict_() : count(0u),generation(1u){}
+            vector<_Entry_> slots;
+            string keys;                //词条内容；
+            size_t count;
+            uint32_t generation;
+        };
+
+        string* _out_;
+        Layout _layout_;
+        size_t _fieldNum_;
+        size_t _lengthPos_;
+        vector<bool> _dictionary_;
+        vector<_Dict_> _dict_;                  //各字典字段的词条表；
+        vector<const char*> _blockData_;        //当前列块的字段指针（行优先）；
+        vector<unsigned long> _blockLength_;    //当前列块的字段长度；
+        size_t _blockRows_;
+
+        void _PutField(size_t field , const char* data , unsigned long length);
+        void _FlushBlock();
+        static char* _PutVarint(char* ptr , uint64_t value);  //写入栈上缓冲，返回写入后的位置；
+        static uint64_t _Hash(const char* data , unsigned long length);
+        static void _ClearDict(_Dict_ &dict);
+};
+
+
+//----------------------------------------------------------------------//
+//
+//              *******   函数实现   *******
+//
+
+//  开始编码；
+void RowEncoder::Begin(string &out , Layout layout , const vector<string> &fieldNames ,
+        const vector<bool> &dictionary , uint64_t rowCount , size_t sizeHint){
+    _out_ = &out;
+    _layout_ = layout;
+    _fieldNum_ = fieldNames.size();
+    _dictionary_ = dictionary;
+    _dictionary_.resize(_fieldNum_ , false);
+    if( _dict_.size() < _fieldNum_ )
+        _dict_.resize(_fieldNum_);
+    for(size_t i=0u;i<_fieldNum_;i++)
+        _ClearDict(_dict_[i]);
+    _blockRows_ = 0u;
+    if( _layout_ == COLUMNS ){
+        _blockData_.resize(ROWENCODER_BLOCKROWS * _fieldNum_);
+        _blockLength_.resize(ROWENCODER_BLOCKROWS * _fieldNum_);
+    }
+
+    out.clear();
+    out.reserve(sizeHint);
+    out += 'D';
+    out += 'B';
+    out += (char)ROWENCODER_VERSION;
+    out += (char)_layout_;
+    _lengthPos_ = out.size();
+    out.append(4u , '\0');
+    PutVarint(out , _fieldNum_);
+    for(size_t i=0u;i<_fieldNum_;i++){
+        PutVarint(out , fieldNames[i].size());
+        out += fieldNames[i];
+        out += (char)( _dictionary_[i] ? 1 : 0 );
+    }
+    PutVarint(out , rowCount);
+}
+
+//  编码一行（按列块布局时先缓存字段指针，满块后写出）；
+void RowEncoder::AddRow(const char* const* row , const unsigned long* lengths){
+    if( _layout_ == ROWS ){
+        for(size_t i=0u;i<_fieldNum_;i++)
+            _PutField(i , row[i] , row[i] == NULL ? 0u : lengths[i]);
+        return;
+    }
+    size_t base = _blockRows_ * _fieldNum_;
+    for(size_t i=0u;i<_fieldNum_;i++){
+        _blockData_[base + i] = row[i];
+        _blockLength_[base + i] = ( row[i] == NULL ? 0u : lengths[i] );
+    }
+    if( ++_blockRows_ == ROWENCODER_BLOCKROWS )
+        _FlushBlock();
+}
+
+//  结束编码：写出尾部，补全总长度；
+void RowEncoder::Finish(const vector<pair<string,string> > &trailer){
+    if( _layout_ == COLUMNS && _blockRows_ != 0u )
+        _FlushBlock();
+    PutVarint(*_out_ , trailer.size());
+    for(auto &item : trailer){
+        PutVarint(*_out_ , item.first.size());
+        *_out_ += item.first;
+        PutVarint(*_out_ , item.second.size());
+        *_out_ += item.second;
+    }
+    uint32_t total = (uint32_t)_out_->size();
+    for(size_t i=0u;i<4u;i++)
+        (*_out_)[_lengthPos_ + i] = (char)( (total >> (8u * i)) & 0xFFu );
+}
+
+//  写入 varint；
+void RowEncoder::PutVarint(string &out , uint64_t value){
+    while( value >= 0x80u ){
+        out += (char)( (value & 0x7Fu) | 0x80u );
+        value >>= 7;
+    }
+    out += (char)value;
+}
+
+//  编码错误信息：二进制客户端同样收到完整的帧；
+void RowEncoder::EncodeError(string &out , const string &message){
+    out.clear();
+    out += 'D';
+    out += 'B';
+    out += (char)ROWENCODER_VERSION;
+    out += (char)ERROR;
+    out.append(4u , '\0');
+    PutVarint(out , message.size());
+    out += message;
+    uint32_t total = (uint32_t)out.size();
+    for(size_t i=0u;i<4u;i++)
+        out[4u + i] = (char)( (total >> (8u * i)) & 0xFFu );
+}
+
+//  以文本格式追加一行（NULL 写作 "NULL"）；
+void RowEncoder::AppendText(string &out , const char* const* row ,
+        const unsigned long* lengths , size_t fieldNum){
+    for(size_t field = 0u;field<fieldNum;field++){
+        if( row[field] != NULL )
+            out.append( row[field] , lengths[field] );
+        else
+            out += "NULL";
+        out += " | " ;
+    }
+    out += '\n';
+}
+
+//  编码单个字段值；
+void RowEncoder::_PutField(size_t field , const char* data , unsigned long length){
+    if( data == NULL ){
+        *_out_ += '\0';
+        return;
+    }
+    char prefix[24];
+    char* ptr = prefix;
+    if( _dictionary_[field] ){
+        _Dict_ &dict = _dict_[field];
+        if( ( dict.count + 1u ) * 2u > dict.slots.size() ){
+            //  扩容并重新插入当前代的词条；
+            vector<_Entry_> old;
+            old.swap(dict.slots);
+            dict.slots.assign( max((size_t)64u , old.size() * 2u) , _Entry_() );
+            for(auto &slot : dict.slots) slot.generation = 0u;
+            size_t mask = dict.slots.size() - 1u;
+            for(auto &entry : old){
+                if( entry.generation != dict.generation )
+                    continue;
+                size_t i = (size_t)entry.hash & mask;
+                while( dict.slots[i].generation == dict.generation )
+                    i = ( i + 1u ) & mask;
+                dict.slots[i] = entry;
+            }
+        }
+        uint64_t hash = _Hash(data , length);
+        size_t mask = dict.slots.size() - 1u , i = (size_t)hash & mask;
+        while( dict.slots[i].generation == dict.generation ){
+            _Entry_ &entry = dict.slots[i];
+            if( entry.hash == hash && entry.length == length &&
+                    memcmp(dict.keys.data() + entry.offset , data , length) == 0 ){
+                if( entry.id + 2u < 0x80u )
+                    *_out_ += (char)( entry.id + 2u );
+                else
+                    _out_->append( prefix , _PutVarint(prefix , entry.id + 2u) - prefix );
+                return;
+            }
+            i = ( i + 1u ) & mask;
+        }
+        _Entry_ &entry = dict.slots[i];
+        entry.offset = dict.keys.size();
+        dict.keys.append(data , length);
+        entry.length = length;
+        entry.hash = hash;
+        entry.id = dict.count ++;
+        entry.generation = dict.generation;
+        *ptr++ = '\1';
+        ptr = _PutVarint(ptr , length);
+        _out_->append( prefix , ptr - prefix );
+    } else if( length + 1u < 0x80u ){
+        *_out_ += (char)( length + 1u );     //短字段的前缀只有一个字节；
+    } else {
+        _out_->append( prefix , _PutVarint(ptr , (uint64_t)length + 1u) - prefix );
+    }
+    _out_->append( data , length );
+}
+
+//  写出当前列块；
+void RowEncoder::_FlushBlock(){
+    PutVarint(*_out_ , _blockRows_);
+    for(size_t i=0u;i<_fieldNum_;i++)
+        for(size_t r=0u;r<_blockRows_;r++)
+            _PutField(i , _blockData_[r * _fieldNum_ + i] , _blockLength_[r * _fieldNum_ + i]);
+    _blockRows_ = 0u;
+}
+
+//  写入 varint，返回写入后的位置；
+char* RowEncoder::_PutVarint(char* ptr , uint64_t value){
+    while( value >= 0x80u ){
+        *ptr++ = (char)( (value & 0x7Fu) | 0x80u );
+        value >>= 7;
+    }
+    *ptr++ = (char)value;
+    return ptr;
+}
+
+//  散列：按 8 字节分组相乘混合；
+uint64_t RowEncoder::_Hash(const char* data , unsigned long length){
+    uint64_t hash = 0x9E3779B97F4A7C15ull ^ length , word;
+    while( length >= 8u ){
+        memcpy(&word , data , 8u);
+        hash = ( hash ^ word ) * 0xFF51AFD7ED558CCDull;
+        hash ^= hash >> 32;
+        data += 8u;
+        length -= 8u;
+    }
+    if( length != 0u ){
+        word = 0u;
+        for(unsigned long i=0u;i<length;i++)
+            word |= (uint64_t)(unsigned char)data[i] << (8u * i);
+        hash = ( hash ^ word ) * 0xC4CEB9FE1A85EC53ull;
+    }
+    return hash ^ ( hash >> 29 );
+}
+
+//  清空词条表：推进代数，使全部槽位失效；
+void RowEncoder::_ClearDict(_Dict_ &dict){
+    dict.count = 0u;
+    dict.keys.clear();
+    if( ++dict.generation == 0u ){
+        for(auto &slot : dict.slots) slot.generation = 0u;
+        dict.generation = 1u;
+    }
+}
+
+#endif
@@ -9,6 +9,10 @@
 //  功能特点：
 //      1、支持应用层级的 心跳检测，保证连接的有效性和资源分配的合理性
 //      2、使用线程池进行客户端并发响应，提高处理效率和信息吞吐量
+//      3、线程池绑核策略由环境变量 DDB_AFFINITY 配置："none"（默认）、"compact"、"scatter"、"cores:0,2,4-7"
+//      4、按客户端 IP 限制并发连接数与连接频率（见 ClientLimiter.h），任务以客户端 IP 为公平键加入线程池，
+//         线程池饱和时各客户端轮流得到线程；每个任务是一条连接（由一个线程处理到断开），
+//         因此公平以连接为单位，同一连接上的请求按顺序执行，请求级的限制由限流完成；
 //
 //  制作信息：
 //      韩佩恩  2019 于 上海同济大学；
@@ -31,7 +35,9 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <map>
+#include <stdlib.h>
 #include "ThreadPool.h" //  线程池对象
+#include "ClientLimiter.h"  //  客户端限流
 
 #pragma once
 using namespace std;
@@ -62,6 +68,8 @@ class Server_IPV4_TCP : public Server{
         //  Socket 心跳检测
         virtual void HeartBeat();               //心跳检测主函数；
         virtual void HeartBeat_ADD(int client); //输入客户端监听值，将某次连接加入心跳检测集和；
+        static size_t HeartBeat_Sweep(map<int,int> &heartCount , int maxCount);//单次轮询，返回断开的连接数；
+        static void HeartBeat_Refresh(map<int,int> &heartCount , int client);  //刷新（或加入）监控对象；
 
     protected:
         ThreadPool* _pool_;                     //线程池指针；
@@ -110,7 +118,8 @@ Server_IPV4_TCP::Server_IPV4_TCP( int serverPort , int listenNum ,
     _listenNum_ = listenNum;
     _Initial();     //Socket初始化；
     _Bind();        //Socket端口绑定；
-    _pool_ = new ThreadPool(threadNumMax,threadNumMin,threadNumInitial,threadNumDn); //线程池创建；
+    _pool_ = new ThreadPool(threadNumMax,threadNumMin,threadNumInitial,threadNumDn,
+            ThreadPool__Affinity::Parse( getenv("DDB_AFFINITY") ));    //线程池创建（按配置绑核）；
     _heartCount_ = new map<int,int>;    //心跳检测集和创建；
     _Listen();      //开始监听；
 }
@@ -136,26 +145,32 @@ void Server_IPV4_TCP::HeartBeat(){
             sleep(sleepTime);
             continue;
         }
-        //对监控对象进行轮询；
-        for(auto it = _heartCount_->begin();it != _heartCount_->end();it++){
-            if( (*it).second >= maxCount ){
-                close( (*it).first );   //关闭超时对象的连接，释放Recv等阻塞；
-                _heartCount_->erase(it);//取消该对象监控；
-                continue;
-            } else {
-                (*it).second ++;    //监控值递增；
-            }
-        }
+        HeartBeat_Sweep( *_heartCount_ , maxCount );    //对监控对象进行轮询；
         sleep(sleepTime);   //睡眠SleepTime秒；
     }
 }
 //  添加监控对象，若对象已存在，则刷新；
 void Server_IPV4_TCP::HeartBeat_ADD(int client){
-    if( _heartCount_ -> count(client) != 0){
-        _heartCount_ ->find(client)->second = 0;
-    } else {
-        _heartCount_ -> insert( pair<int,int>(client,0) );
+    HeartBeat_Refresh( *_heartCount_ , client );
+}
+//  单次轮询：监控值达到阈值的连接被关闭并移出监控表，其余监控值递增；
+size_t Server_IPV4_TCP::HeartBeat_Sweep(map<int,int> &heartCount , int maxCount){
+    size_t closed = 0u;
+    for(auto it = heartCount.begin();it != heartCount.end();){
+        if( (*it).second >= maxCount ){
+            close( (*it).first );       //关闭超时对象的连接，释放Recv等阻塞；
+            it = heartCount.erase(it);  //取消该对象监控；
+            closed ++;
+        } else {
+            (*it).second ++;    //监控值递增；
+            it ++;
+        }
     }
+    return closed;
+}
+//  刷新监控对象，若对象不存在则加入；
+void Server_IPV4_TCP::HeartBeat_Refresh(map<int,int> &heartCount , int client){
+    heartCount[client] = 0;
 }
 
 //  初始化Socket；
@@ -212,8 +227,15 @@ void Server_DDB<OnlineService>::_TaskHandle(){
         if( ( _confd_ = accept( _socket_fd_ , (struct sockaddr*)&_clientAddr_ , &_addrLen_) ) == -1){
             continue;
         }
+        //超出该客户端的连接数或连接频率时立即断开；
+        uint32_t clientIp = _clientAddr_.sin_addr.s_addr;
+        if( !ClientLimiter::Shared().TryConnect( clientIp ) ){
+            send( _confd_ , LIMIT_CONNMSG , strlen(LIMIT_CONNMSG) , MSG_NOSIGNAL | MSG_DONTWAIT );
+            close( _confd_ );
+            continue;
+        }
         HeartBeat_ADD( _confd_ );   //添加心跳检测对象；
-        _pool_ ->AddTask( new OnlineService( _confd_ , _clientAddr_ , _heartCount_) );//添加任务池；
+        _pool_ ->AddTask( new OnlineService( _confd_ , _clientAddr_ , _heartCount_) , clientIp );//添加任务池（按客户端公平排队）；
     }
 
     close( _socket_fd_ );   //关闭服务器Socket；
@@ -0,0 +1,23 @@
+//*********************************************************************
+//
+//  ServerMain.cpp ：
+//      文献检索服务器的入口：  ddb_server [端口]，端口缺省为 DDB_DEFAULTPORT；
+//      后端、限流与绑核由 ddb_backends.conf 及环境变量 DDB_BACKENDS、DDB_LIMITS、DDB_AFFINITY 配置；
+//
+//*********************************************************************
+
+#include <stdlib.h>
+#include "ServerDDB.h"
+#include "DocumentDB.h"
+
+#define DDB_DEFAULTPORT 9000
+
+int main(int argc , char* argv[]){
+    int port = ( argc > 1 ) ? atoi(argv[1]) : DDB_DEFAULTPORT;
+    if( port <= 0 || port > 65535 ){
+        cout << "ERROR !\n\tusage: " << argv[0] << " [port]" << endl;
+        return 1;
+    }
+    Server_DDB<ServerTask> server(port);
+    return 0;
+}
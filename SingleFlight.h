@@ -0,0 +1,123 @@
+//*********************************************************************
+//
+//  SingleFlight.h ：
+//      1、定义并实现 相同请求的合并执行 : class SingleFlight;
+//
+//  功能特点：
+//      1、同一键值同时只执行一次：首个请求执行，其余并发的相同请求等待并共享其结果；
+//      2、结果以 shared_ptr<const string> 共享，各连接直接发送同一编码缓冲，无需复制；
+//      3、执行结束即移除键值，不缓存结果（与是否启用结果缓存无关）；
+//      4、统计实际执行次数与被合并的请求数；
+//
+//  制作信息：
+//      韩佩恩  2019 于 上海同济大学；
+//
+//*********************************************************************
+
+#if!defined SINGLEFLIGHT_H
+#define SINGLEFLIGHT_H
+
+#include <string>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <unordered_map>
+#pragma once
+using namespace std;
+
+//  相同请求的合并执行
+class SingleFlight{
+    public:
+        typedef shared_ptr<const string> Response;
+        SingleFlight() : _executed_(0u),_coalesced_(0u){}
+        SingleFlight(const SingleFlight & flight) = delete;
+        SingleFlight & operator=(const SingleFlight & flight) = delete;
+
+        //  执行 func（返回 string）或等待相同键值的执行结果；coalesced 指示结果是否来自其他请求；
+        template<class F> Response Do(const string &key , F func , bool &coalesced);
+        size_t Executed(){ return _executed_.load(); }      //实际执行次数；
+        size_t Coalesced(){ return _coalesced_.load(); }    //被合并的请求数；
+        size_t InFlight();                                  //正在执行的键值数；
+
+    private:
+        struct _Call_{
+            _Call_() : isDone(false){}
+            mutex mutexDone;
+            condition_variable conditionDone;
+            bool isDone;
+            Response value;     //执行失败（异常）时为空；
+        };
+        //  保证执行者无论正常结束或抛出异常都会发布结果并移除键值；
+        struct _Publisher_{
+            _Publisher_(SingleFlight* flight , const string &key , const shared_ptr<_Call_> &call)
+                : flight(flight),key(key),call(call){}
+            ~_Publisher_(){
+                flight->_mutex_.lock();
+                flight->_calls_.erase(key);
+                flight->_mutex_.unlock();
+                lock_guard<mutex> lock(call->mutexDone);
+                call->isDone = true;
+                call->conditionDone.notify_all();
+            }
+            SingleFlight* flight;
+            const string &key;
+            shared_ptr<_Call_> call;
+        };
+
+        unordered_map<string , shared_ptr<_Call_> > _calls_;    //正在执行的请求；
+        mutex _mutex_;
+        atomic<size_t> _executed_ , _coalesced_;
+};
+
+
+//----------------------------------------------------------------------//
+//
+//              *******   函数实现   *******
+//
+
+//  执行或等待：执行者的异常照常抛出，此时等待者改为自行执行；
+template<class F>
+SingleFlight::Response SingleFlight::Do(const string &key , F func , bool &coalesced){
+    shared_ptr<_Call_> call;
+    bool isLeader = false;
+    _mutex_.lock();
+    auto it = _calls_.find(key);
+    if( it == _calls_.end() ){
+        call = make_shared<_Call_>();
+        _calls_.insert( make_pair(key , call) );
+        isLeader = true;
+    } else {
+        call = it->second;
+    }
+    _mutex_.unlock();
+
+    if( isLeader ){
+        _executed_ ++;
+        coalesced = false;
+        _Publisher_ publisher(this , key , call);
+        Response value = make_shared<const string>( func() );
+        call->value = value;
+        return value;
+    }
+
+    {  //  block
+        unique_lock<mutex> lock(call->mutexDone);
+        call->conditionDone.wait(lock , [&call]{ return call->isDone; });
+    }
+    if( call->value == nullptr ){
+        _executed_ ++;
+        coalesced = false;
+        return make_shared<const string>( func() );
+    }
+    _coalesced_ ++;
+    coalesced = true;
+    return call->value;
+}
+//  正在执行的键值数；
+size_t SingleFlight::InFlight(){
+    lock_guard<mutex> lock(_mutex_);
+    return _calls_.size();
+}
+
+#endif
@@ -0,0 +1,341 @@
+//*********************************************************************
+//
+//  SuggestIndex.h ：
+//      1、定义 前缀补全的候选项             : struct SuggestMatch;
+//      2、定义并实现 前缀补全索引           : class PrefixSuggester;
+//
+//  功能特点：
+//      1、作者：规范化（小写、去标点）后的全名及从每个姓名片段开始的后缀均可作为前缀匹配的键，
+//         例如 “Geoffrey Hinton” 可由 “geo” 或 “hin” 补全；标题：规范化后的单词（忽略停用词）；
+//      2、热度为包含该词条的文档数；字典树每个节点保存其子树内热度最高的 SUGGEST_NODETOPK 个词条，
+//         查询只需沿前缀走到对应节点，与词条总数无关；
+//      3、字典树以 首子节点/兄弟节点 数组存储；变更只重算受影响路径上的节点（自深向浅，每节点一次），
+//         节点的前 k 由 本节点词条 与 各子节点的前 k 归并得到；
+//      4、与分面索引共用同一份快照与变更日志（见 FacetIndex.h、sql/ChangeLog.sql）；
+//         热度降为 0 的词条不再出现在结果中，其节点在下次快照重建时回收；
+//
+//  制作信息：
+//      韩佩恩  2019 于 上海同济大学；
+//
+//*********************************************************************
+
+#if!defined SUGGESTINDEX_H
+#define SUGGESTINDEX_H
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <algorithm>
+#include <unordered_map>
+#include <cctype>
+#include <stdint.h>
+#include "FacetIndex.h"
+#pragma once
+using namespace std;
+
+#define SUGGEST_NODETOPK 10     //每个节点保存的候选数（单次补全返回数的上限）；
+#define SUGGEST_MINWORD  2      //标题单词的最短长度；
+
+//  前缀补全的候选项；
+struct SuggestMatch{
+    string term;        //作者原名或标题单词；
+    size_t count;       //热度（文档数）；
+};
+
+//  前缀补全索引
+//  主要功能：1、由快照重建、按变更增量更新；2、返回前缀下热度最高的词条；
+class PrefixSuggester{
+    public:
+        enum Kind{ AUTHER = 0 , TITLE = 1 };
+        explicit PrefixSuggester(Kind kind) : _kind_(kind),_watermark_(0u){ _Clear(); }
+        PrefixSuggester(const PrefixSuggester & suggester) = delete;
+        PrefixSuggester & operator=(const PrefixSuggester & suggester) = delete;
+
+        void Reset(const vector<FacetChange> &snapshot , uint64_t watermark);   //由快照重建；
+        void Apply(const vector<FacetChange> &changes);     //按 Seq 顺序应用变更；
+        vector<SuggestMatch> Suggest(const string &prefix , size_t topN);   //热度降序的补全；
+        size_t Terms();                 //热度非 0 的词条数；
+        size_t Nodes();                 //字典树节点数；
+        static string Normalize(const string &text);        //小写并以单个空格连接字母数字片段；
+
+    private:
+        struct _Node_{
+            _Node_(unsigned char label , uint16_t depth)
+                : label(label),depth(depth),child(0u),sibling(0u){}
+            unsigned char label;
+            uint16_t depth;
+            uint32_t child , sibling;   //首子节点、下一兄弟节点（0 表示无，0 号为根）；
+            vector<uint32_t> terms;     //以本节点结尾的词条；
+            vector<uint32_t> top;       //子树内热度最高的词条（降序）；
+        };
+        struct _Term_{
+            string display;             //返回给客户端的文本；
+            vector<string> keys;        //前缀匹配的键；
+            size_t count;
+        };
+
+        Kind _kind_;
+        vector<_Node_> _nodes_;
+        vector<_Term_> _terms_;
+        unordered_map<string , uint32_t> _termIds_;         //规范化文本 -> 词条；
+        unordered_map<int , vector<uint32_t> > _docTerms_;  //文档 -> 其词条（用于修改与删除时撤销）；
+        size_t _liveTerms_;
+        uint64_t _watermark_;
+        mutex _mutex_;
+
+        void _Clear();
+        void _Upsert(const FacetChange &change , vector<uint32_t> &touched);
+        void _Erase(int docId , vector<uint32_t> &touched);
+        void _Extract(const FacetChange &change , vector<uint32_t> &terms);  //文档的词条（去重）；
+        uint32_t _TermId(const string &normalized , const string &display);
+        uint32_t _Walk(const string &key , bool create);    //沿键走到节点，不存在时返回 0 或创建；
+        void _Recompute(const vector<uint32_t> &touched);   //重算受影响路径上各节点的前 k；
+        bool _Before(uint32_t x , uint32_t y) const;        //排序：热度降序，同热度按文本升序；
+        static bool _IsStopWord(const string &word);
+};
+
+
+//----------------------------------------------------------------------//
+//
+//              *******   函数实现   *******
+//
+
+//  由快照重建；
+void PrefixSuggester::Reset(const vector<FacetChange> &snapshot , uint64_t watermark){
+    lock_guard<mutex> lock(_mutex_);
+    _Clear();
+    vector<uint32_t> touched;
+    for(auto &change : snapshot)
+        _Upsert(change , touched);
+    _Recompute(touched);
+    _watermark_ = watermark;
+}
+
+//  应用变更（先更新热度，最后统一重算受影响节点）；
+void PrefixSuggester::Apply(const vector<FacetChange> &changes){
+    lock_guard<mutex> lock(_mutex_);
+    vector<uint32_t> touched;
+    for(auto &change : changes){
+        if( change.seq <= _watermark_ )
+            continue;
+        if( change.op == 'D' )
+            _Erase(change.docId , touched);
+        else
+            _Upsert(change , touched);
+        _watermark_ = change.seq;
+    }
+    _Recompute(touched);
+}
+
+//  补全：规范化前缀后走到对应节点，直接取其前 k；
+vector<SuggestMatch> PrefixSuggester::Suggest(const string &prefix , size_t topN){
+    vector<SuggestMatch> res;
+    string key = Normalize(prefix);
+    if( !prefix.empty() && isspace((unsigned char)prefix.back()) && !key.empty() )
+        key += ' ';     //保留末尾空格：“geoffrey ” 只补全后续片段；
+    lock_guard<mutex> lock(_mutex_);
+    uint32_t node = _Walk(key , false);
+    if( node == 0u && !key.empty() )
+        return res;
+    for(auto term : _nodes_[node].top){
+        if( res.size() >= topN )
+            break;
+        SuggestMatch match = { _terms_[term].display , _terms_[term].count };
+        res.push_back(match);
+    }
+    return res;
+}
+
+//  热度非 0 的词条数；
+size_t PrefixSuggester::Terms(){
+    lock_guard<mutex> lock(_mutex_);
+    return _liveTerms_;
+}
+//  字典树节点数；
+size_t PrefixSuggester::Nodes(){
+    lock_guard<mutex> lock(_mutex_);
+    return _nodes_.size();
+}
+
+//  小写并以单个空格连接字母数字片段（非 ASCII 字节原样保留）；
+string PrefixSuggester::Normalize(const string &text){
+    string res;
+    bool isGap = false;
+    for(size_t i=0u;i<text.size();i++){
+        unsigned char c = (unsigned char)text[i];
+        if( c >= 0x80 || isalnum(c) ){
+            if( isGap && !res.empty() )
+                res += ' ';
+            res += (char)( c < 0x80 ? tolower(c) : c );
+            isGap = false;
+        } else {
+            isGap = true;
+        }
+    }
+    return res;
+}
+
+//  清空，仅保留根节点；
+void PrefixSuggester::_Clear(){
+    _nodes_.clear();
+    _nodes_.push_back( _Node_(0u , 0u) );
+    _terms_.clear();
+    _termIds_.clear();
+    _docTerms_.clear();
+    _liveTerms_ = 0u;
+}
+
+//  新增或修改文档：撤销旧词条的热度，再计入新词条；
+void PrefixSuggester::_Upsert(const FacetChange &change , vector<uint32_t> &touched){
+    _Erase(change.docId , touched);
+    vector<uint32_t> &terms = _docTerms_[change.docId];
+    _Extract(change , terms);
+    for(auto term : terms){
+        if( _terms_[term].count ++ == 0u )
+            _liveTerms_ ++;
+        touched.push_back(term);
+    }
+}
+//  删除文档：撤销其词条的热度；
+void PrefixSuggester::_Erase(int docId , vector<uint32_t> &touched){
+    auto it = _docTerms_.find(docId);
+    if( it == _docTerms_.end() )
+        return;
+    for(auto term : it->second){
+        if( -- _terms_[term].count == 0u )
+            _liveTerms_ --;
+        touched.push_back(term);
+    }
+    _docTerms_.erase(it);
+}
+
+//  文档的词条：作者为一个词条，标题为其中每个非停用词（同一文档内去重）；
+void PrefixSuggester::_Extract(const FacetChange &change , vector<uint32_t> &terms){
+    if( _kind_ == AUTHER ){
+        string normalized = Normalize(change.auther);
+        if( !normalized.empty() )
+            terms.push_back( _TermId(normalized , change.auther) );
+        return;
+    }
+    string title = Normalize(change.title);
+    size_t begin = 0u;
+    while( begin < title.size() ){
+        size_t end = title.find(' ' , begin);
+        if( end == string::npos ) end = title.size();
+        string word = title.substr(begin , end - begin);
+        begin = end + 1u;
+        if( word.size() < SUGGEST_MINWORD || _IsStopWord(word) )
+            continue;
+        uint32_t term = _TermId(word , word);
+        if( find(terms.begin(),terms.end(),term) == terms.end() )
+            terms.push_back(term);
+    }
+}
+
+//  取得词条编号（新词条登记其全部键并建立路径）；
+uint32_t PrefixSuggester::_TermId(const string &normalized , const string &display){
+    auto it = _termIds_.find(normalized);
+    if( it != _termIds_.end() )
+        return it->second;
+    uint32_t id = (uint32_t)_terms_.size();
+    _Term_ term;
+    term.display = display;
+    term.count = 0u;
+    term.keys.push_back(normalized);
+    if( _kind_ == AUTHER ){
+        for(size_t pos = normalized.find(' ');pos != string::npos;pos = normalized.find(' ' , pos + 1u))
+            term.keys.push_back( normalized.substr(pos + 1u) );
+    }
+    for(auto &key : term.keys)
+        _nodes_[ _Walk(key , true) ].terms.push_back(id);
+    _terms_.push_back(term);
+    _termIds_.insert( make_pair(normalized , id) );
+    return id;
+}
+
+//  沿键走到节点（子节点按标签升序链接）；
+uint32_t PrefixSuggester::_Walk(const string &key , bool create){
+    uint32_t node = 0u;
+    for(size_t i=0u;i<key.size();i++){
+        unsigned char label = (unsigned char)key[i];
+        uint32_t prev = 0u , next = _nodes_[node].child;
+        while( next != 0u && _nodes_[next].label < label ){
+            prev = next;
+            next = _nodes_[next].sibling;
+        }
+        if( next == 0u || _nodes_[next].label != label ){
+            if( !create )
+                return 0u;
+            uint32_t added = (uint32_t)_nodes_.size();
+            _nodes_.push_back( _Node_(label , (uint16_t)min(i + 1u , (size_t)UINT16_MAX)) );
+            _nodes_[added].sibling = next;
+            if( prev == 0u )
+                _nodes_[node].child = added;
+            else
+                _nodes_[prev].sibling = added;
+            next = added;
+        }
+        node = next;
+    }
+    return node;
+}
+
+//  重算受影响路径上各节点的前 k：按深度降序处理，保证子节点先于父节点；
+void PrefixSuggester::_Recompute(const vector<uint32_t> &touched){
+    vector<pair<uint16_t , uint32_t> > nodes;  //(深度,节点)；
+    vector<uint32_t> terms(touched);
+    sort(terms.begin(),terms.end());
+    terms.erase( unique(terms.begin(),terms.end()) , terms.end() );
+    for(auto term : terms){
+        for(auto &key : _terms_[term].keys){
+            uint32_t node = 0u;
+            nodes.push_back( make_pair((uint16_t)0u , node) );
+            for(size_t i=0u;i<key.size();i++){
+                node = _nodes_[node].child;
+                while( _nodes_[node].label != (unsigned char)key[i] )
+                    node = _nodes_[node].sibling;
+                nodes.push_back( make_pair(_nodes_[node].depth , node) );
+            }
+        }
+    }
+    sort(nodes.begin(),nodes.end(),[](const pair<uint16_t,uint32_t> &x , const pair<uint16_t,uint32_t> &y){
+            return x.first != y.first ? x.first > y.first : x.second < y.second; });
+    nodes.erase( unique(nodes.begin(),nodes.end()) , nodes.end() );
+
+    vector<uint32_t> candidates;
+    for(auto &item : nodes){
+        _Node_ &node = _nodes_[item.second];
+        candidates.clear();
+        for(auto term : node.terms)
+            if( _terms_[term].count != 0u )
+                candidates.push_back(term);
+        for(uint32_t child = node.child;child != 0u;child = _nodes_[child].sibling)
+            candidates.insert(candidates.end() , _nodes_[child].top.begin() , _nodes_[child].top.end());
+        //  同一作者可经多个键出现在不同子树，先去重；
+        sort(candidates.begin(),candidates.end());
+        candidates.erase( unique(candidates.begin(),candidates.end()) , candidates.end() );
+        size_t keep = min(candidates.size() , (size_t)SUGGEST_NODETOPK);
+        partial_sort(candidates.begin() , candidates.begin() + keep , candidates.end() ,
+                [this](uint32_t x , uint32_t y){ return _Before(x , y); });
+        node.top.assign(candidates.begin() , candidates.begin() + keep);
+    }
+}
+
+//  排序：热度降序，同热度按文本升序；
+bool PrefixSuggester::_Before(uint32_t x , uint32_t y) const {
+    if( _terms_[x].count != _terms_[y].count )
+        return _terms_[x].count > _terms_[y].count;
+    return _terms_[x].display < _terms_[y].display;
+}
+
+//  标题停用词；
+bool PrefixSuggester::_IsStopWord(const string &word){
+    static const char* stopWords[] = { "an","and","are","as","at","by","for","from","in","into",
+        "is","of","on","or","the","to","via","with" };
+    for(auto stop : stopWords)
+        if( word == stop )
+            return true;
+    return false;
+}
+
+#endif
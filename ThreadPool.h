@@ -5,12 +5,23 @@
 //      2、定义并实现 线程列表对象及其功能 : class ThreadList;
 //      3、定义并实现 线程池及其功能       : class ThreadPool;
 //      4、定义 线程池接受任务的结构       : class ThreadPool__Task;
+//      5、定义并实现 任务队列的任务槽     : class ThreadPool__Slot;
+//      6、定义并实现 轻量级完成计数器     : class ThreadPool__Latch;
+//      7、定义并实现 线程绑核策略         : class ThreadPool__Affinity;
+//      8、定义并实现 空闲线程计数         : class ThreadPool__Idle;
 //
 //  设计模式：生产消费者模式；
 //  
 //  功能特点：
 //      1、线程池根据任务规模，自动调节线程池的大小；
 //      2、线程池的运行支持运行中的 起停和终止；
+//      3、除派生 ThreadPool__Task 外，可直接提交可调用对象（Submit 返回 future，Post 不返回结果），
+//         小型可调用对象内联存储于任务槽中，无需单独分配堆内存；ParallelFor 基于其实现并行循环；
+//      4、支持线程绑核（紧凑 / 分散 / 指定核心表），线程局部缓冲由绑核后的线程首次写入，
+//         从而分配在该线程所在的 NUMA 节点；统计各线程执行任务数与 CPU 迁移次数（取自内核调度统计）；
+//      5、任务可附带公平键（如客户端 IP），任务队列按键分组并轮转出队，任务只交给空闲线程，
+//         线程池饱和时某个键的大量任务不会阻塞其他键的任务（公平以任务为单位）；
+//         调度线程在没有空闲线程或没有任务时阻塞等待，线程执行完任务后将其唤醒；
 //
 //
 //  制作信息：
@@ -28,31 +39,200 @@
 #include <thread>
 #include <unistd.h>
 #include <list>
+#include <deque>
+#include <unordered_map>
 #include <mutex>
+#include <memory>
+#include <cstddef>
+#include <exception>
+#include <type_traits>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <sched.h>
+#include <pthread.h>
+#include <sys/syscall.h>
 #include <future>
 #include <functional>
 #include <atomic>
 #include <condition_variable>
+#include <chrono>
 #pragma once
 using namespace std;
 
+#define THREADPOOL_INLINESIZE 48    //任务槽内联存储可调用对象的最大字节数；
+#define THREADPOOL_NUMAPATH "/sys/devices/system/node/"    //NUMA 拓扑信息目录；
+#define THREADPOOL_MAXNODES 64      //探测的最大 NUMA 节点数；
+#define THREADPOOL_ADJUSTPERIOD 3   //调整线程池大小的间隔（秒）；
+#define THREADPOOL_SCHEDPATH "/proc/self/task/"     //线程调度统计（含 se.nr_migrations）所在目录；
+#define THREADPOOL_KEEPKEYS 64      //保留的空任务队列数（公平键 0 的队列始终保留），避免反复分配队列；
+
 //  线程池支持的任务基类，任务须由Run()函数实现；
 class ThreadPool__Task{
     public:
         ThreadPool__Task(){}
+        virtual ~ThreadPool__Task(){}
         thread::id GetThreadID(){ return this_thread::get_id(); }
         virtual void Run() = 0;
 };
 
+//  任务队列中的任务槽（仅可移动）
+//  持有以下之一：1、ThreadPool__Task 指针（执行后 delete）；
+//                2、可调用对象（不超过 THREADPOOL_INLINESIZE 字节且可无异常移动时内联存储，否则堆上存储）；
+class ThreadPool__Slot{
+    public:
+        ThreadPool__Slot():_ops_(nullptr),_task_(nullptr){}
+        explicit ThreadPool__Slot(ThreadPool__Task* task):_ops_(nullptr),_task_(task){}
+        ThreadPool__Slot(ThreadPool__Slot && other):_ops_(nullptr),_task_(nullptr){ _MoveFrom(other); }
+        ThreadPool__Slot & operator=(ThreadPool__Slot && other){
+            if( this != &other ){
+                Reset();
+                _MoveFrom(other);
+            }
+            return *this;
+        }
+        ThreadPool__Slot(const ThreadPool__Slot & other) = delete;
+        ThreadPool__Slot & operator=(const ThreadPool__Slot & other) = delete;
+        ~ThreadPool__Slot(){ Reset(); }
+
+        template<class F> static ThreadPool__Slot FromCallable(F &&func);  //由可调用对象构造；
+        bool Empty() const { return _ops_ == nullptr && _task_ == nullptr; }
+        void Run();     //执行并释放所持任务；
+        void Reset();   //释放所持任务（不执行）；
+        ThreadPool__Task* Release();    //交出派生任务指针的所有权；
+
+    private:
+        struct _Ops_{
+            void (*invoke)(void* storage);
+            void (*move)(void* dst , void* src);    //移动构造至 dst 并析构 src；
+            void (*destroy)(void* storage);
+        };
+        template<class F> struct _InlineOps_{
+            static void Invoke(void* storage){ (*static_cast<F*>(storage))(); }
+            static void Move(void* dst , void* src){
+                new (dst) F( move(*static_cast<F*>(src)) );
+                static_cast<F*>(src)->~F();
+            }
+            static void Destroy(void* storage){ static_cast<F*>(storage)->~F(); }
+            static const _Ops_* Get(){ static const _Ops_ ops = { &Invoke , &Move , &Destroy }; return &ops; }
+        };
+        template<class F> struct _HeapOps_{
+            static void Invoke(void* storage){ (**static_cast<F**>(storage))(); }
+            static void Move(void* dst , void* src){ *static_cast<F**>(dst) = *static_cast<F**>(src); }
+            static void Destroy(void* storage){ delete *static_cast<F**>(storage); }
+            static const _Ops_* Get(){ static const _Ops_ ops = { &Invoke , &Move , &Destroy }; return &ops; }
+        };
+
+        template<class F> struct _IsInline_ : integral_constant<bool ,     //是否可内联存储；
+            sizeof(F) <= THREADPOOL_INLINESIZE && alignof(F) <= alignof(max_align_t) &&
+            is_nothrow_move_constructible<F>::value>{};
+
+        typename aligned_storage<THREADPOOL_INLINESIZE , alignof(max_align_t)>::type _storage_;
+        const _Ops_* _ops_;         //可调用对象的操作表；
+        ThreadPool__Task* _task_;   //派生任务指针；
+
+        void _MoveFrom(ThreadPool__Slot &other);
+        //  按 _IsInline_ 分派存储方式，只实例化实际使用的一种；
+        template<class Func , class F> void _Store(F &&func , true_type);   //内联存储；
+        template<class Func , class F> void _Store(F &&func , false_type);  //堆上存储；
+};
+
+//  轻量级完成计数器：计数归零前 Wait() 阻塞；
+class ThreadPool__Latch{
+    public:
+        explicit ThreadPool__Latch(size_t counts):_counts_(counts){}
+        void CountDown(){
+            lock_guard<mutex> lock(_mutex_);
+            if( _counts_ != 0u && --_counts_ == 0u )
+                _condition_.notify_all();
+        }
+        void Wait(){
+            unique_lock<mutex> lock(_mutex_);
+            _condition_.wait(lock , [this]{ return _counts_ == 0u; });
+        }
+        bool IsReady(){
+            lock_guard<mutex> lock(_mutex_);
+            return _counts_ == 0u;
+        }
+    private:
+        size_t _counts_;
+        mutex _mutex_;
+        condition_variable _condition_;
+};
+
+//  空闲线程计数：线程变为空闲时加一，取得任务或被移除时减一；调度线程在计数为零时 Wait() 阻塞；
+class ThreadPool__Idle{
+    public:
+        ThreadPool__Idle():_counts_(0){}
+        void Add(long num){
+            lock_guard<mutex> lock(_mutex_);
+            _counts_ += num;
+            if( num > 0 )
+                _condition_.notify_all();
+        }
+        bool Wait(const atomic<bool> &isEnd){   //等到有空闲线程或结束，返回是否有空闲线程；
+            unique_lock<mutex> lock(_mutex_);
+            _condition_.wait(lock , [this , &isEnd]{ return _counts_ > 0 || isEnd.load(); });
+            return _counts_ > 0;
+        }
+        void Wake(){                            //结束时唤醒等待者；
+            lock_guard<mutex> lock(_mutex_);
+            _condition_.notify_all();
+        }
+    private:
+        long _counts_;      //取得任务与执行完毕的先后可能交错，短暂为负；
+        mutex _mutex_;
+        condition_variable _condition_;
+};
+
+
+//  线程绑核策略
+//  NONE：不绑核；COMPACT：按节点依次填满各核心；SCATTER：在各节点间轮流分配；EXPLICIT：使用指定核心表；
+//  新线程总是分配到策略顺序中当前线程数最少的核心，线程池动态增减后仍保持均衡；
+class ThreadPool__Affinity{
+    public:
+        enum Policy{ NONE = 0 , COMPACT = 1 , SCATTER = 2 , EXPLICIT = 3 };
+        ThreadPool__Affinity(Policy policy = NONE , const vector<int> &cores = vector<int>());
+        ThreadPool__Affinity(const ThreadPool__Affinity &other);   //复制策略（负载清零）；
+        static ThreadPool__Affinity Parse(const char* spec);    //解析 "none" "compact" "scatter" "cores:0,2,4-7"；
+        static int NodeOf(int cpu);         //返回核心所在的 NUMA 节点（未知为0）；
+        Policy GetPolicy() const { return _policy_; }
+        int Acquire();                      //为新线程选取核心（NONE 返回 -1）；
+        void Release(int cpu);              //线程退出时归还核心；
+
+    private:
+        Policy _policy_;
+        vector<int> _order_;                //按策略排列的候选核心；
+        vector<size_t> _load_;              //各候选核心上的线程数；
+        mutex _mutex_;
+
+        static vector<int> _ParseCpuList(const string &list);
+        static vector<vector<int> > _Topology();    //各节点上当前进程可用的核心；
+};
+
+//  线程执行情况统计；
+struct ThreadPool__WorkerStat{
+    thread::id id;          //线程号；
+    int cpu;                //绑定的核心（未绑定为 -1）；
+    int node;               //最近一次执行所在的 NUMA 节点；
+    int tid;                //内核线程号（尚未运行时为 0）；
+    size_t tasks;           //已执行任务数；
+    size_t migrations;      //内核统计的 CPU 迁移次数（/proc 不可用时为执行任务前后观察到的次数）；
+};
 
 //  线程池中的线程对象；
 class ThreadWorker{
     public:
-        ThreadWorker():_myTask_(nullptr),_isStop_(false){
+        ThreadWorker(int cpu = -1 , ThreadPool__Idle* idle = nullptr)
+            :_isStop_(false),_cpu_(cpu),_lastCpu_(-1),_tid_(0),_tasks_(0u),_migrations_(0u),_idle_(idle){
             _isRunning_.store(true);                        //标记该线程为运行状态；
+            _isBusy_.store(false);
+            if( _idle_ != nullptr ) _idle_->Add(1);         //新线程为空闲；
             _myThread_ = thread(&ThreadWorker::Run , this);   //创建线程池的线程；
         }
-        ~ThreadWorker(){
+        virtual ~ThreadWorker(){
             if( !_isStop_ ) Stop(); //停止线程任务；
             if( _myThread_.joinable() ) _myThread_.join();//线程回收；
         }
@@ -61,27 +241,41 @@ class ThreadWorker{
         ThreadWorker & operator=(const ThreadWorker & thread) = delete;
         ThreadWorker & operator=(const ThreadWorker && thread) = delete;
         bool Assign(ThreadPool__Task* task);//取得线程任务；
+        bool Assign(ThreadPool__Slot &task);//取得线程任务（成功时移走任务槽）；
         void Stop();                        //暂停；
         void Notify();                      //通知；
         void Notify_all();                  //通知所有；
-        bool IsExecuting();                 //判断线程是否正在执行任务；
+        bool IsExecuting();                 //判断任务槽中是否有待执行的任务；
+        bool IsIdle();                      //判断线程是否空闲（任务槽为空且未在执行任务）；
         thread::id GetThreadId();           //取得线程号；
+        int GetCpu();                       //取得绑定的核心；
+        ThreadPool__WorkerStat GetStat();   //取得执行情况统计（迁移次数为观察值，不读 /proc）；
         virtual void Run();                 //任务执行接口；
+        static char* LocalBuffer(size_t size);  //当前线程的局部缓冲（由本线程首次写入，位于本节点）；
+        static long KernelMigrations(int tid);  //读取内核统计的迁移次数（失败返回 -1）；
 
    private:
         thread  _myThread_; //创建线程对象；
-        ThreadPool__Task*  _myTask_;    //任务指针；
+        ThreadPool__Slot  _myTask_;     //任务槽；
         mutex  _mutexThread_ , _mutexCondition_ , _mutexTask_;//线程锁、条件锁、任务锁；
         condition_variable  _my_condition_; //运行条件变量；
         atomic<bool>  _isRunning_;  //运行状态；
+        atomic<bool>  _isBusy_;     //正在执行任务（在 _mutexTask_ 内置位）；
         bool  _isStop_;             //停止状态；
+        int  _cpu_;                 //绑定的核心；
+        atomic<int>  _lastCpu_;     //最近一次执行所在核心；
+        atomic<int>  _tid_;         //内核线程号（用于读取调度统计）；
+        atomic<size_t>  _tasks_ , _migrations_;    //任务数、观察到的迁移次数；
+        ThreadPool__Idle* _idle_;   //空闲线程计数（在 _mutexTask_ 内随空闲状态变化）；
+        void _Bind();               //在本线程内执行绑核；
 };
 
 //  线程池的线程队列
 //  主要功能：添加、返回、删除线程；暂停所有线程；动态线程池增减功能；
 class ThreadList{
     public:
-        ThreadList(const size_t counts){ _Assign(counts); }
+        ThreadList(const size_t counts , const ThreadPool__Affinity &affinity = ThreadPool__Affinity())
+            : _affinity_(affinity){ _Assign(counts); }
         ~ThreadList(){
             while( !_threadList_.empty() ){
                 ThreadWorker* tmp = _threadList_.front();
@@ -94,12 +288,18 @@ class ThreadList{
         void Pop();                         //弹出最前部线程；
         size_t Size();                      //查询队列长度；
         void Stop();                        //停止队列全部任务；
+        bool WaitIdle(const atomic<bool> &isEnd);   //等到有空闲线程或结束，返回是否有空闲线程；
+        void WakeIdle();                    //唤醒等待空闲线程者（用于结束）；
+        bool Assign(ThreadPool__Slot &task);//将任务交给一个空闲线程（无空闲线程时返回 false）；
         void DynamicList_Plus(const size_t &num);   //动态增加线程；
-        void DynamicList_Minus(const size_t &num);  //动态缩减线程；
+        size_t DynamicList_Minus(const size_t &num);//动态缩减空闲线程，返回实际缩减数；
+        vector<ThreadPool__WorkerStat> Stats();     //各线程执行情况；
 
     private:
         list<ThreadWorker*> _threadList_;     //线程表；
+        ThreadPool__Idle _idle_;            //空闲线程计数；
         mutex _mutexThread_;                //线程锁；
+        ThreadPool__Affinity _affinity_;    //绑核策略；
         void _Assign(const size_t counts);
 };
 
@@ -109,7 +309,8 @@ class ThreadList{
 class ThreadPool{
     public:
         ThreadPool(const size_t maxcount , const size_t mincount,
-                const size_t counts , const size_t DN) : _isExit_(false){
+                const size_t counts , const size_t DN ,
+                const ThreadPool__Affinity &affinity = ThreadPool__Affinity()) : _taskCounts_(0u),_isExit_(false){
             if(maxcount < mincount){ cout << "ERROR !\n\tThreadPool: maxcount < mincount" << endl; exit(1); } 
             _myThread_Counts_ = counts;
             _myThread_MaxNum_ = maxcount;
@@ -117,18 +318,32 @@ class ThreadPool{
             _myThread_DN_ = DN;
             _myIsRunning_.store(true);
             _myIsEnd_.store(false);
-            _myThreadList_ = new ThreadList(_myThread_Counts_); //创建线程表；
+            _myThreadList_ = new ThreadList(_myThread_Counts_ , affinity); //创建线程表；
             _myThread_ = thread(&ThreadPool::Run , this);               //空闲线程轮询并使其执行任务；
             _myThread_NumContral_ = thread(&ThreadPool::_DynamicThread , this); //创建线程监控线程池大小；
             Start();
+            lock_guard<mutex> lock(_RegistryMutex());
+            _Registry().push_back(this);
         }
         ~ThreadPool(){
             cout << "~ThreadPool()  !!!" << endl;
+            {  //  block
+                lock_guard<mutex> lock(_RegistryMutex());
+                vector<ThreadPool*> &pools = _Registry();
+                pools.erase(remove(pools.begin() , pools.end() , this) , pools.end());
+            }
             if( !_isExit_ ) Exit();
         }
         size_t ThreadCounts();  //返回线程数量；
+        vector<ThreadPool__WorkerStat> WorkerStats();   //返回各线程执行情况（含 CPU 迁移次数）；
+        string Describe();      //统计信息，每行：  “名称 数值” 或 “pool_worker 序号 核心 节点 任务数 迁移次数”；
+        static string DescribeAll();    //进程内全部线程池的统计信息；
         bool IsRunning();   //判断是否运行；
-        void AddTask(ThreadPool__Task* task);//添加任务至任务队列；
+        void AddTask(ThreadPool__Task* task , uint64_t key = 0u);//添加任务至任务队列（key 为公平键）；
+        template<class F> auto Submit(F &&func) -> future<decltype(func())>;//提交可调用对象，返回其结果；
+        template<class F> void Post(F &&func);  //提交可调用对象，不返回结果；
+        template<class F> void ParallelFor(size_t begin , size_t end , size_t grain , F func);
+                                                //并行执行 func(i)，i∈[begin,end)，调用线程参与执行并等待完成；
         void Start();   //开始任务；
         void Stop();    //停止任务；
         void Exit();    //退出任务并回收线程；
@@ -138,14 +353,37 @@ class ThreadPool{
         thread _myThread_;
         thread _myThread_NumContral_;
         ThreadList* _myThreadList_;
-        list<ThreadPool__Task*> _taskList_;
+        unordered_map<uint64_t , deque<ThreadPool__Slot> > _taskList_;  //按公平键分组的任务队列；
+        deque<uint64_t> _taskKeys_;         //有待执行任务的公平键，轮转出队（空队列至多保留 THREADPOOL_KEEPKEYS 个）；
+        atomic<size_t> _taskCounts_;        //待执行任务总数；
         atomic<bool> _myIsRunning_;
         atomic<bool> _myIsEnd_;
         atomic<size_t> _myThread_Counts_ , _myThread_MaxNum_ , _myThread_MinNum_,_myThread_DN_;
-        condition_variable _condition_Task_,_condition_Running_;
-        mutex _mutexTask_,_mutexThread_,_mutexRunning_;
+        condition_variable _condition_Task_,_condition_Running_,_condition_End_;
+        mutex _mutexTask_,_mutexThread_,_mutexRunning_,_mutexEnd_;
         bool _isExit_;
         void _DynamicThread();
+        static mutex& _RegistryMutex();
+        static vector<ThreadPool*>& _Registry();    //进程内的全部线程池（用于统计）；
+        void _AddSlot(ThreadPool__Slot &&task , uint64_t key = 0u);  //添加任务槽至任务队列；
+        bool _PopSlot(ThreadPool__Slot &task);  //按公平键轮转取出任务（需持有 _mutexTask_）；
+
+        template<class R> struct _PackagedCall_{   //包装 packaged_task 以便存入任务槽；
+            explicit _PackagedCall_(packaged_task<R()> &&task):_task_(move(task)){}
+            void operator()(){ _task_(); }
+            packaged_task<R()> _task_;
+        };
+        template<class F> struct _ParallelState_{  //ParallelFor 的共享状态；
+            _ParallelState_(size_t begin , size_t end , size_t grain , F &&func , size_t chunks)
+                :next(begin),end(end),grain(grain),func(move(func)),latch(chunks){}
+            atomic<size_t> next;
+            size_t end , grain;
+            F func;
+            ThreadPool__Latch latch;    //每完成一个分块计数减一；
+            mutex mutexError;
+            exception_ptr error;
+            void Work();                //领取并执行分块直至无剩余；
+        };
 };
 
 
@@ -154,14 +392,193 @@ class ThreadPool{
 //              *******   函数实现   *******
 //
 
+//  由可调用对象构造任务槽；
+template<class F>
+ThreadPool__Slot ThreadPool__Slot::FromCallable(F &&func){
+    typedef typename decay<F>::type Func;
+    ThreadPool__Slot slot;
+    slot._Store<Func>( forward<F>(func) , _IsInline_<Func>() );
+    return slot;
+}
+template<class Func , class F>
+void ThreadPool__Slot::_Store(F &&func , true_type){
+    new (&_storage_) Func( forward<F>(func) );
+    _ops_ = _InlineOps_<Func>::Get();
+}
+template<class Func , class F>
+void ThreadPool__Slot::_Store(F &&func , false_type){
+    *reinterpret_cast<Func**>(&_storage_) = new Func( forward<F>(func) );
+    _ops_ = _HeapOps_<Func>::Get();
+}
+//  执行并释放所持任务；
+void ThreadPool__Slot::Run(){
+    if( _task_ != nullptr ){
+        ThreadPool__Task* task = _task_;
+        _task_ = nullptr;
+        task->Run();
+        delete task;
+    } else if( _ops_ != nullptr ){
+        _ops_->invoke(&_storage_);
+        Reset();
+    }
+}
+//  释放所持任务；
+void ThreadPool__Slot::Reset(){
+    if( _ops_ != nullptr ){
+        _ops_->destroy(&_storage_);
+        _ops_ = nullptr;
+    }
+    if( _task_ != nullptr ){
+        delete _task_;
+        _task_ = nullptr;
+    }
+}
+//  交出派生任务指针的所有权；
+ThreadPool__Task* ThreadPool__Slot::Release(){
+    ThreadPool__Task* task = _task_;
+    _task_ = nullptr;
+    return task;
+}
+//  从另一任务槽移入；
+void ThreadPool__Slot::_MoveFrom(ThreadPool__Slot &other){
+    _task_ = other._task_;
+    other._task_ = nullptr;
+    if( other._ops_ != nullptr ){
+        other._ops_->move(&_storage_ , &other._storage_);
+        _ops_ = other._ops_;
+        other._ops_ = nullptr;
+    }
+}
+
+//  绑核策略：按拓扑生成候选核心顺序；
+ThreadPool__Affinity::ThreadPool__Affinity(Policy policy , const vector<int> &cores) : _policy_(policy){
+    if( _policy_ == EXPLICIT ){
+        _order_ = cores;
+    } else if( _policy_ != NONE ){
+        vector<vector<int> > nodes = _Topology();
+        if( _policy_ == COMPACT ){
+            for(auto &node : nodes)
+                _order_.insert(_order_.end() , node.begin() , node.end());
+        } else {
+            for(size_t i=0u;;i++){
+                bool any = false;
+                for(auto &node : nodes){
+                    if( i < node.size() ){
+                        _order_.push_back(node[i]);
+                        any = true;
+                    }
+                }
+                if( !any ) break;
+            }
+        }
+    }
+    if( _order_.empty() )
+        _policy_ = NONE;
+    _load_.assign(_order_.size() , 0u);
+}
+ThreadPool__Affinity::ThreadPool__Affinity(const ThreadPool__Affinity &other) : _policy_(other._policy_),
+    _order_(other._order_),_load_(other._order_.size() , 0u){}
+//  解析绑核配置串；
+ThreadPool__Affinity ThreadPool__Affinity::Parse(const char* spec){
+    string str = ( spec == nullptr ) ? "" : spec;
+    if( str == "compact" ) return ThreadPool__Affinity(COMPACT);
+    if( str == "scatter" ) return ThreadPool__Affinity(SCATTER);
+    if( str.compare(0 , 6 , "cores:") == 0 )
+        return ThreadPool__Affinity(EXPLICIT , _ParseCpuList(str.substr(6)));
+    if( !str.empty() && str != "none" )
+        cout << "ERROR !\n\tThreadPool__Affinity: unknown policy " << str << endl;
+    return ThreadPool__Affinity(NONE);
+}
+//  返回核心所在的 NUMA 节点；
+int ThreadPool__Affinity::NodeOf(int cpu){
+    static const vector<vector<int> > nodes = _Topology();
+    for(size_t n=0u;n<nodes.size();n++)
+        if( find(nodes[n].begin() , nodes[n].end() , cpu) != nodes[n].end() )
+            return (int)n;
+    return 0;
+}
+//  选取当前线程数最少的候选核心；
+int ThreadPool__Affinity::Acquire(){
+    lock_guard<mutex> lock(_mutex_);
+    if( _policy_ == NONE )
+        return -1;
+    size_t best = 0u;
+    for(size_t i=1u;i<_order_.size();i++)
+        if( _load_[i] < _load_[best] )
+            best = i;
+    _load_[best] ++;
+    return _order_[best];
+}
+//  归还核心；
+void ThreadPool__Affinity::Release(int cpu){
+    lock_guard<mutex> lock(_mutex_);
+    for(size_t i=0u;i<_order_.size();i++){
+        if( _order_[i] == cpu && _load_[i] != 0u ){
+            _load_[i] --;
+            return;
+        }
+    }
+}
+//  解析 "0-3,8,10-11" 形式的核心表；
+vector<int> ThreadPool__Affinity::_ParseCpuList(const string &list){
+    vector<int> cpus;
+    stringstream stream(list);
+    string item;
+    while( getline(stream , item , ',') ){
+        if( item.empty() ) continue;
+        size_t dash = item.find('-');
+        int first = atoi(item.c_str());
+        int last = ( dash == string::npos ) ? first : atoi(item.c_str() + dash + 1);
+        for(int cpu=first;cpu<=last;cpu++)
+            cpus.push_back(cpu);
+    }
+    return cpus;
+}
+//  读取各 NUMA 节点的核心表，仅保留当前进程可用的核心；无 NUMA 信息时视为单节点；
+vector<vector<int> > ThreadPool__Affinity::_Topology(){
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    sched_getaffinity(0 , sizeof(allowed) , &allowed);
+    vector<vector<int> > nodes;
+    for(int n=0;n<THREADPOOL_MAXNODES;n++){
+        ifstream file( THREADPOOL_NUMAPATH "node" + to_string(n) + "/cpulist" );
+        if( !file.is_open() )
+            continue;
+        string line;
+        getline(file , line);
+        vector<int> cpus;
+        for(auto cpu : _ParseCpuList(line))
+            if( cpu < CPU_SETSIZE && CPU_ISSET(cpu , &allowed) )
+                cpus.push_back(cpu);
+        if( !cpus.empty() )
+            nodes.push_back(cpus);
+    }
+    if( nodes.empty() ){
+        nodes.push_back(vector<int>());
+        for(int cpu=0;cpu<CPU_SETSIZE;cpu++)
+            if( CPU_ISSET(cpu , &allowed) )
+                nodes[0].push_back(cpu);
+    }
+    return nodes;
+}
+
 //  为线程取得具体任务；
 bool ThreadWorker::Assign(ThreadPool__Task* task){
+    ThreadPool__Slot slot(task);
+    if( Assign(slot) )
+        return true;
+    slot.Release();     //分配失败时任务仍归调用者所有；
+    return false;
+}
+bool ThreadWorker::Assign(ThreadPool__Slot &task){
     _mutexTask_.lock();
-    if( _myTask_ != nullptr ){
+    if( !_myTask_.Empty() ){
         _mutexTask_.unlock();
         return false;
     }
-    _myTask_ = task;
+    if( _idle_ != nullptr && !_isBusy_.load() )
+        _idle_->Add(-1);
+    _myTask_ = move(task);
     _mutexTask_.unlock();
     _my_condition_.notify_one();
     return true;
@@ -169,6 +586,7 @@ bool ThreadWorker::Assign(ThreadPool__Task* task){
 //  暂停该线程任务；
 void ThreadWorker::Stop(){
     _isRunning_.store( false );
+    { lock_guard<mutex> lock(_mutexTask_); }   //线程检查条件与开始等待之间不会错过下面的通知；
     _mutexThread_.lock();
     if(_myThread_.joinable()){
         _my_condition_.notify_all();
@@ -191,38 +609,111 @@ void ThreadWorker::Notify_all(){
 //  判断是否正在执行；
 bool ThreadWorker::IsExecuting(){
     _mutexTask_.lock();
-    bool res = ( _myTask_ == nullptr );
+    bool res = _myTask_.Empty();
     _mutexTask_.unlock();
     return !res;
 }
+//  判断是否空闲；
+bool ThreadWorker::IsIdle(){
+    lock_guard<mutex> lock(_mutexTask_);
+    return _myTask_.Empty() && !_isBusy_.load();
+}
 //  取得线程号；
 thread::id ThreadWorker::GetThreadId(){
-    return this_thread::get_id();
+    return _myThread_.get_id();
+}
+//  取得绑定的核心；
+int ThreadWorker::GetCpu(){
+    return _cpu_;
+}
+//  取得执行情况统计；
+ThreadPool__WorkerStat ThreadWorker::GetStat(){
+    ThreadPool__WorkerStat stat;
+    stat.id = _myThread_.get_id();
+    stat.cpu = _cpu_;
+    int lastCpu = _lastCpu_.load();
+    stat.node = lastCpu < 0 ? -1 : ThreadPool__Affinity::NodeOf(lastCpu);
+    stat.tid = _tid_.load();
+    stat.tasks = _tasks_.load();
+    stat.migrations = _migrations_.load();
+    return stat;
+}
+//  当前线程的局部缓冲：容量不足时由本线程重新分配并清零（首次写入决定所在节点）；
+char* ThreadWorker::LocalBuffer(size_t size){
+    static thread_local vector<char> buffer;
+    if( buffer.size() < size )
+        buffer.assign(size , '\0');
+    return buffer.data();
+}
+//  在本线程内绑核；
+void ThreadWorker::_Bind(){
+    if( _cpu_ < 0 )
+        return;
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(_cpu_ , &cpus);
+    if( pthread_setaffinity_np(pthread_self() , sizeof(cpus) , &cpus) != 0 )
+        cout << "ERROR !\n\tThreadWorker: bind to cpu " << _cpu_ << " failed" << endl;
+}
+//  读取内核统计的迁移次数（/proc/self/task/线程号/sched 中的 se.nr_migrations，含两次任务之间的迁移）；
+long ThreadWorker::KernelMigrations(int tid){
+    if( tid == 0 )
+        return -1;
+    ifstream file( THREADPOOL_SCHEDPATH + to_string(tid) + "/sched" );
+    string line;
+    while( getline(file , line) ){
+        if( line.compare(0 , 16 , "se.nr_migrations") != 0 )
+            continue;
+        size_t colon = line.find(':');
+        return ( colon == string::npos ) ? -1 : atol( line.c_str() + colon + 1 );
+    }
+    return -1;
 }
 //  执行任务；
 void ThreadWorker::Run(){
-    ThreadPool__Task* task = nullptr;
+    ThreadPool__Slot task;
+    _tid_.store( (int)syscall(SYS_gettid) );
+    _Bind();
     while( true ){
         //当要求暂停时若没有任务则结束线程
         if(!_isRunning_.load()){
             _mutexTask_.lock();
-            if( _myTask_ == nullptr ){
+            if( _myTask_.Empty() ){
                 _mutexTask_.unlock();
                 break;
             }
             _mutexTask_.unlock();
         }
         //有任务则执行任务
-        unique_lock<mutex> lock(_mutexTask_);
-        _my_condition_.wait(lock,
-                [this]{return !((_myTask_ == nullptr) && this->_isRunning_.load());} );
-        task = _myTask_;
-        _myTask_ = nullptr;
-        if( task == nullptr )
+        {  //  block
+            unique_lock<mutex> lock(_mutexTask_);
+            _my_condition_.wait(lock,
+                    [this]{return !(_myTask_.Empty() && this->_isRunning_.load());} );
+            task = move(_myTask_);
+            _isBusy_.store( !task.Empty() );
+        }
+        if( task.Empty() )
             continue;
-        task->Run();
-        delete task;
-        task = nullptr;
+        //  统计迁移：与上次执行所在核心不同即计一次；
+        int cpu = sched_getcpu();
+        int lastCpu = _lastCpu_.exchange(cpu);
+        if( lastCpu >= 0 && lastCpu != cpu )
+            _migrations_ ++;
+        _tasks_ ++;
+        try{
+            task.Run();
+        } catch(const exception &e){
+            cout << "ERROR !\n\tThreadWorker: task exception: " << e.what() << endl;
+        } catch(...){
+            cout << "ERROR !\n\tThreadWorker: task exception !" << endl;
+        }
+        task.Reset();
+        {  //  block   任务槽为空时变为空闲，唤醒等待空闲线程的调度线程；
+            lock_guard<mutex> lock(_mutexTask_);
+            _isBusy_.store(false);
+            if( _idle_ != nullptr && _myTask_.Empty() )
+                _idle_->Add(1);
+        }
     }
 }
 
@@ -268,52 +759,196 @@ void ThreadList::Stop(){
         thread_ptr->Stop();
     _mutexThread_.unlock();
 }
+//  各线程执行情况：锁内只复制计数，读 /proc 在释放线程锁之后进行（线程已被回收时保留观察值）；
+vector<ThreadPool__WorkerStat> ThreadList::Stats(){
+    vector<ThreadPool__WorkerStat> stats;
+    _mutexThread_.lock();
+    for(auto thread_ptr : _threadList_)
+        stats.push_back( thread_ptr->GetStat() );
+    _mutexThread_.unlock();
+    for(auto &stat : stats){
+        long migrations = ThreadWorker::KernelMigrations(stat.tid);
+        if( migrations >= 0 )
+            stat.migrations = (size_t)migrations;
+    }
+    return stats;
+}
+//  等待空闲线程：由线程变为空闲时唤醒，不轮询线程表；
+bool ThreadList::WaitIdle(const atomic<bool> &isEnd){
+    return _idle_.Wait(isEnd);
+}
+void ThreadList::WakeIdle(){
+    _idle_.Wake();
+}
+//  将任务交给一个空闲线程（任务槽为空且未在执行任务）：从队首依次轮转检查，交出后该线程移至队尾；
+//  正在执行任务的线程任务槽同样为空，不能据此判断，否则任务会排在一个长时间运行的任务之后；
+bool ThreadList::Assign(ThreadPool__Slot &task){
+    lock_guard<mutex> lock(_mutexThread_);
+    for(size_t i=_threadList_.size();i>0u;i--){
+        ThreadWorker* thread_ptr = _threadList_.front();
+        _threadList_.splice(_threadList_.end() , _threadList_ , _threadList_.begin());  //移至队尾，不重新分配节点；
+        if( thread_ptr ->IsIdle() && thread_ptr ->Assign(task) )
+            return true;
+    }
+    return false;
+}
 //  动态增加线程数量；
 void ThreadList::DynamicList_Plus(const size_t &num){
     _mutexThread_.lock();
     for(size_t i=0u;i<num;i++)
-        _threadList_.push_back(new ThreadWorker());
+        _threadList_.push_back(new ThreadWorker( _affinity_.Acquire() , &_idle_ ));
     _mutexThread_.unlock();
 }
-//  动态缩减线程数量；
-void ThreadList::DynamicList_Minus(const size_t &num){
+//  动态缩减线程数量：只移除空闲线程（不轮转队列），移出后停止、回收并归还其核心；
+//  任务只经 Assign 在持有线程锁时交出，被移出的空闲线程不会再取得任务；
+size_t ThreadList::DynamicList_Minus(const size_t &num){
+    vector<ThreadWorker*> victims;
     _mutexThread_.lock();
-    for(size_t i=num;i>0;i--){
-        auto thread_ptr = _threadList_.front();
-        auto list_it = _threadList_.begin();
-        while( thread_ptr ->IsExecuting() ){
-            _threadList_.pop_front();
-            _threadList_.push_back(thread_ptr);
-            thread_ptr = _threadList_.front();
+    for(auto list_it = _threadList_.begin();list_it != _threadList_.end() && victims.size() < num;){
+        if( (*list_it) ->IsIdle() ){
+            victims.push_back(*list_it);
+            list_it = _threadList_.erase(list_it);
+            _idle_.Add(-1);
+        } else {
             list_it ++;
         }
-        _threadList_.erase(list_it);
     }
     _mutexThread_.unlock();
+    for(auto thread_ptr : victims){
+        int cpu = thread_ptr ->GetCpu();
+        thread_ptr ->Stop();
+        delete thread_ptr;
+        _affinity_.Release(cpu);
+    }
+    return victims.size();
 }
 //  批量创建线程；
 void ThreadList::_Assign(const size_t counts){
     for(size_t i=0u;i<counts;i++)
-        _threadList_.push_back(new ThreadWorker());
+        _threadList_.push_back(new ThreadWorker( _affinity_.Acquire() , &_idle_ ));
 }
 
 //  返回线程数量；
 size_t ThreadPool::ThreadCounts(){
     return _myThread_Counts_.load();
 }
+//  返回各线程执行情况；
+vector<ThreadPool__WorkerStat> ThreadPool::WorkerStats(){
+    return _myThreadList_->Stats();
+}
+//  统计信息：线程数、待执行任务数及各线程执行情况；
+string ThreadPool::Describe(){
+    string res;
+    res  = "pool_threads " + to_string( ThreadCounts() ) + "\n";
+    res += "pool_tasks_queued " + to_string( _taskCounts_.load() ) + "\n";
+    vector<ThreadPool__WorkerStat> stats = WorkerStats();
+    for(size_t i=0u;i<stats.size();i++)
+        res += "pool_worker " + to_string(i) + " " + to_string(stats[i].cpu) + " " + to_string(stats[i].node) + " " +
+            to_string(stats[i].tasks) + " " + to_string(stats[i].migrations) + "\n";
+    return res;
+}
+//  进程内全部线程池的统计信息；
+string ThreadPool::DescribeAll(){
+    string res;
+    lock_guard<mutex> lock(_RegistryMutex());
+    for(auto pool : _Registry())
+        res += pool->Describe();
+    return res;
+}
+mutex& ThreadPool::_RegistryMutex(){
+    static mutex registryMutex;
+    return registryMutex;
+}
+vector<ThreadPool*>& ThreadPool::_Registry(){
+    static vector<ThreadPool*> pools;
+    return pools;
+}
 //  判断是否运行
 bool ThreadPool::IsRunning(){
     return _myIsRunning_.load();
 }
 //  增加任务至任务列表；
-void ThreadPool::AddTask(ThreadPool__Task* task){
+void ThreadPool::AddTask(ThreadPool__Task* task , uint64_t key){
     if( task == nullptr )
         return;
+    _AddSlot( ThreadPool__Slot(task) , key );
+}
+void ThreadPool::_AddSlot(ThreadPool__Slot &&task , uint64_t key){
     _mutexTask_.lock();
-    _taskList_.push_back(task);
+    deque<ThreadPool__Slot> &queue = _taskList_[key];
+    if( queue.empty() )
+        _taskKeys_.push_back(key);
+    queue.push_back( move(task) );
+    _taskCounts_ ++;
     _mutexTask_.unlock();
     _condition_Task_.notify_one();
 }
+//  取出队首键的首个任务，该键仍有任务时移至队尾；
+//  取空的队列予以保留，同一公平键再次提交时不必重新分配队列与散列节点（队列过多时才释放非 0 键的空队列）；
+bool ThreadPool::_PopSlot(ThreadPool__Slot &task){
+    if( _taskKeys_.empty() )
+        return false;
+    uint64_t key = _taskKeys_.front();
+    _taskKeys_.pop_front();
+    auto it = _taskList_.find(key);
+    task = move(it->second.front());
+    it->second.pop_front();
+    if( !it->second.empty() )
+        _taskKeys_.push_back(key);
+    else if( key != 0u && _taskList_.size() > THREADPOOL_KEEPKEYS )
+        _taskList_.erase(it);
+    _taskCounts_ --;
+    return true;
+}
+//  提交可调用对象，异常与返回值经 future 传回；
+template<class F>
+auto ThreadPool::Submit(F &&func) -> future<decltype(func())>{
+    typedef decltype(func()) R;
+    packaged_task<R()> task( forward<F>(func) );
+    future<R> res = task.get_future();
+    _AddSlot( ThreadPool__Slot::FromCallable( _PackagedCall_<R>( move(task) ) ) );
+    return res;
+}
+//  提交可调用对象，不返回结果；
+template<class F>
+void ThreadPool::Post(F &&func){
+    _AddSlot( ThreadPool__Slot::FromCallable( forward<F>(func) ) );
+}
+//  并行循环：按 grain 分块，线程池与调用线程共同领取分块；
+//  调用线程总能独自完成全部分块，故在池内任务中调用也不会因线程耗尽而死锁；
+template<class F>
+void ThreadPool::ParallelFor(size_t begin , size_t end , size_t grain , F func){
+    if( begin >= end )
+        return;
+    if( grain == 0u ) grain = 1u;
+    size_t chunks = ( end - begin + grain - 1u ) / grain;
+    shared_ptr<_ParallelState_<F> > state( new _ParallelState_<F>(begin , end , grain , move(func) , chunks) );
+    size_t helpers = min( chunks - 1u , ThreadCounts() );
+    for(size_t i=0u;i<helpers;i++)
+        Post( [state]{ state->Work(); } );
+    state->Work();
+    state->latch.Wait();
+    if( state->error )
+        rethrow_exception(state->error);
+}
+//  领取并执行分块，异常只保留第一个；
+template<class F>
+void ThreadPool::_ParallelState_<F>::Work(){
+    while( true ){
+        size_t first = next.fetch_add(grain);
+        if( first >= end )
+            break;
+        size_t last = min(end , first + grain);
+        try{
+            for(size_t i=first;i<last;i++)
+                func(i);
+        } catch(...){
+            lock_guard<mutex> lock(mutexError);
+            if( !error ) error = current_exception();
+        }
+        latch.CountDown();
+    }
+}
 //  开启任务；
 void ThreadPool::Start(){
     _myIsRunning_.store( true );
@@ -325,8 +960,16 @@ void ThreadPool::Stop(){
 }
 //  退出线程并回收；
 void ThreadPool::Exit(){
-    _myIsEnd_.store( true );
+    {  //  block   在锁内置位，保证调整线程不会错过唤醒；
+        lock_guard<mutex> lock(_mutexEnd_);
+        _myIsEnd_.store( true );
+    }
+    _condition_End_.notify_all();
+    {  //  block   在任务锁内通知，调度线程检查条件与开始等待之间不会错过；
+        lock_guard<mutex> lock(_mutexTask_);
+    }
     _condition_Task_.notify_all();
+    _myThreadList_->WakeIdle();
     _mutexThread_.lock();
     if( _myThread_.joinable() )
         _myThread_.join();
@@ -336,65 +979,55 @@ void ThreadPool::Exit(){
     _myThreadList_->Stop();
     _isExit_ = true;
 }
-//空闲线程轮询并使空闲线程执行任务；
+//  调度线程：等到有空闲线程与待执行任务时，按公平键取出任务交给空闲线程（两者均以条件变量等待，不轮询）；
 void ThreadPool::Run(){
-    ThreadWorker* thread_ptr = nullptr;
-    ThreadPool__Task* task = nullptr;
-    while( true ){
-        if( _myIsEnd_.load() ){
-            break;
-        } else {
-            _mutexTask_.lock();
-            if( _taskList_.empty() ){
-                _mutexTask_.unlock();
-                continue;
-            }
-            _mutexTask_.unlock();
-        }
-
+    ThreadPool__Slot task;
+    while( !_myIsEnd_.load() ){
         {  //  block
             unique_lock<mutex> lockRunning(_mutexRunning_);
             _condition_Running_.wait(lockRunning,
                     [this]{return this->_myIsRunning_.load();});
         }
 
-        thread_ptr = nullptr;
-        task = nullptr;
+        task.Reset();
+
+        //  等到有空闲线程时才按公平键取出任务，轮转的选择发生在真正交出任务的时刻；
+        if( !_myThreadList_ ->WaitIdle(_myIsEnd_) )
+            continue;
 
         {  //  block
             unique_lock<mutex> lock(_mutexTask_);
             _condition_Task_.wait(lock,
-                    [this]{return !(this->_taskList_.empty() && !this->_myIsEnd_.load());});
-            if( !_taskList_.empty() ){
-                task = _taskList_.front();
-                _taskList_.pop_front();
-            }
+                    [this]{return !(this->_taskKeys_.empty() && !this->_myIsEnd_.load());});
+            _PopSlot(task);
         }
 
-        do{
-            thread_ptr = _myThreadList_ ->Top();
-            _myThreadList_ ->Pop();
-            _myThreadList_ ->Push(thread_ptr);
-        } while( thread_ptr ->IsExecuting() );
-
-        thread_ptr ->Assign(task);
-        thread_ptr ->Notify();
+        //  空闲计数与线程的空闲状态在同一任务锁内变化，交出通常不会失败；失败时（线程被直接交予任务）再次等待；
+        while( !task.Empty() && !_myThreadList_ ->Assign(task) ){
+            if( !_myThreadList_ ->WaitIdle(_myIsEnd_) )
+                break;
+            this_thread::yield();
+        }
     }
 }
-//  根据任务规模，动态调整线程池的大小；
+//  根据任务规模，每 THREADPOOL_ADJUSTPERIOD 秒调整线程池的大小（Exit 时立即唤醒并退出）；
 void ThreadPool::_DynamicThread(){
-    size_t taskList_Size = _taskList_.size();
+    size_t taskList_Size = _taskCounts_.load();
     size_t idleThreadList_Size = _myThreadList_ ->Size();
-    while( !_myIsEnd_.load() ){
-        sleep(3);
-        taskList_Size = _taskList_.size();
+    while( true ){
+        {  //  block
+            unique_lock<mutex> lock(_mutexEnd_);
+            if( _condition_End_.wait_for(lock , chrono::seconds(THREADPOOL_ADJUSTPERIOD) ,
+                        [this]{ return this->_myIsEnd_.load(); }) )
+                break;
+        }
+        taskList_Size = _taskCounts_.load();
         idleThreadList_Size = _myThreadList_ ->Size();
         if( taskList_Size == 0 || taskList_Size < idleThreadList_Size){
             if(_myThread_Counts_.load() - _myThread_DN_ < _myThread_MinNum_.load()){
                 continue;
             } else {
-                _myThread_Counts_ -= _myThread_DN_;
-                _myThreadList_ -> DynamicList_Minus(_myThread_DN_);
+                _myThread_Counts_ -= _myThreadList_ -> DynamicList_Minus(_myThread_DN_);
                 continue;
             }
         } 
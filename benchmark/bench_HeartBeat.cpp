@@ -0,0 +1,64 @@
+//*********************************************************************
+//
+//  bench_HeartBeat.cpp ：
+//      心跳检测微基准：监控值刷新、无超时轮询、全部超时驱逐，参数为连接数；
+//      模拟连接使用超出进程上限的描述符，close() 立即返回 EBADF，不影响真实连接；
+//
+//*********************************************************************
+
+#include <benchmark/benchmark.h>
+#include "ServerDDB.h"
+
+#define FAKE_FD_BASE (1 << 24)
+
+static void Fill(map<int,int> &heartCount , int connections , int value){
+    heartCount.clear();
+    for(int i=0;i<connections;i++)
+        heartCount.insert( pair<int,int>(FAKE_FD_BASE + i , value) );
+}
+
+//  刷新：每次迭代刷新全部连接一次（对应每个请求/心跳到达）；
+static void BM_HeartBeat_Refresh(benchmark::State &state){
+    const int connections = (int)state.range(0);
+    map<int,int> heartCount;
+    Fill(heartCount , connections , 1);
+    for(auto _ : state){
+        for(int i=0;i<connections;i++)
+            Server_IPV4_TCP::HeartBeat_Refresh(heartCount , FAKE_FD_BASE + i);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed( state.iterations() * connections );
+}
+
+//  轮询：全部连接活跃，仅递增监控值；
+static void BM_HeartBeat_Sweep(benchmark::State &state){
+    const int connections = (int)state.range(0);
+    map<int,int> heartCount;
+    Fill(heartCount , connections , 0);
+    for(auto _ : state){
+        state.PauseTiming();
+        for(auto &item : heartCount) item.second = 0;
+        state.ResumeTiming();
+        benchmark::DoNotOptimize( Server_IPV4_TCP::HeartBeat_Sweep(heartCount , 4) );
+    }
+    state.SetItemsProcessed( state.iterations() * connections );
+}
+
+//  驱逐：全部连接超时，逐个关闭并移出监控表；
+static void BM_HeartBeat_Evict(benchmark::State &state){
+    const int connections = (int)state.range(0);
+    map<int,int> heartCount;
+    for(auto _ : state){
+        state.PauseTiming();
+        Fill(heartCount , connections , 4);
+        state.ResumeTiming();
+        benchmark::DoNotOptimize( Server_IPV4_TCP::HeartBeat_Sweep(heartCount , 4) );
+    }
+    state.SetItemsProcessed( state.iterations() * connections );
+}
+
+BENCHMARK(BM_HeartBeat_Refresh)->Arg(10000)->Arg(30000)->Arg(100000)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_HeartBeat_Sweep)->Arg(10000)->Arg(30000)->Arg(100000)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_HeartBeat_Evict)->Arg(10000)->Arg(30000)->Arg(100000)->Unit(benchmark::kMicrosecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,73 @@
+//*********************************************************************
+//
+//  bench_RowEncoder.cpp ：
+//      结果编码微基准：文本（" | " 分隔）、二进制按行、二进制按列块，参数为标题长度；
+//
+//*********************************************************************
+
+#include <benchmark/benchmark.h>
+#include "RowEncoder.h"
+
+#define BENCH_ROWS 1000
+
+//  模拟 MySQL 返回的结果集：(Year,Auther,Title)，作者在 50 个取值间重复；
+struct FakeResult{
+    FakeResult(size_t titleLength){
+        for(size_t i=0u;i<BENCH_ROWS;i++){
+            cells.push_back( to_string(1990 + i % 30) );
+            cells.push_back( "Auther Name " + to_string(i % 50) );
+            cells.push_back( string(titleLength , (char)('a' + i % 26)) );
+        }
+        for(size_t i=0u;i<cells.size();i++){
+            pointers.push_back( cells[i].c_str() );
+            lengths.push_back( cells[i].size() );
+        }
+    }
+    size_t SizeHint() const {
+        size_t bytes = 64u;
+        for(auto length : lengths) bytes += length + 4u;
+        return bytes;
+    }
+    vector<string> cells;
+    vector<const char*> pointers;
+    vector<unsigned long> lengths;
+};
+
+static void BM_Encode_Text(benchmark::State &state){
+    FakeResult res( (size_t)state.range(0) );
+    string out;
+    for(auto _ : state){
+        out.clear();
+        out.reserve( res.SizeHint() );
+        for(size_t r=0u;r<BENCH_ROWS;r++)
+            RowEncoder::AppendText(out , &res.pointers[r * 3u] , &res.lengths[r * 3u] , 3u);
+        benchmark::DoNotOptimize( out.data() );
+    }
+    state.SetItemsProcessed( state.iterations() * BENCH_ROWS );
+    state.counters["bytes_per_row"] = (double)out.size() / BENCH_ROWS;
+}
+
+static void EncodeBinary(benchmark::State &state , RowEncoder::Layout layout){
+    FakeResult res( (size_t)state.range(0) );
+    vector<string> names = { "Year" , "Auther" , "Title" };
+    vector<bool> dictionary = { false , true , false };
+    RowEncoder encoder;
+    string out;
+    for(auto _ : state){
+        encoder.Begin(out , layout , names , dictionary , BENCH_ROWS , res.SizeHint());
+        for(size_t r=0u;r<BENCH_ROWS;r++)
+            encoder.AddRow( &res.pointers[r * 3u] , &res.lengths[r * 3u] );
+        encoder.Finish();
+        benchmark::DoNotOptimize( out.data() );
+    }
+    state.SetItemsProcessed( state.iterations() * BENCH_ROWS );
+    state.counters["bytes_per_row"] = (double)out.size() / BENCH_ROWS;
+}
+static void BM_Encode_BinaryRows(benchmark::State &state){ EncodeBinary(state , RowEncoder::ROWS); }
+static void BM_Encode_BinaryColumns(benchmark::State &state){ EncodeBinary(state , RowEncoder::COLUMNS); }
+
+BENCHMARK(BM_Encode_Text)->RangeMultiplier(4)->Range(16,1024);
+BENCHMARK(BM_Encode_BinaryRows)->RangeMultiplier(4)->Range(16,1024);
+BENCHMARK(BM_Encode_BinaryColumns)->RangeMultiplier(4)->Range(16,1024);
+
+BENCHMARK_MAIN();
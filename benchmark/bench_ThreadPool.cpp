@@ -0,0 +1,136 @@
+//*********************************************************************
+//
+//  bench_ThreadPool.cpp ：
+//      线程池微基准：任务提交/分发吞吐量、单任务往返延迟、多线程竞争 AddTask、
+//                    可调用对象提交（Post/Submit）与 ParallelFor、不同绑核策略下的吞吐量与迁移次数；
+//
+//*********************************************************************
+
+#include <benchmark/benchmark.h>
+#include <vector>
+#include "ThreadPool.h"
+
+//  计数任务：执行时将未完成计数减一；
+class CountTask : public ThreadPool__Task{
+    public:
+        CountTask(atomic<long>* pending) : _pending_(pending){}
+        void Run(){ _pending_->fetch_sub(1); }
+    private:
+        atomic<long>* _pending_;
+};
+
+//  等待全部任务完成；
+static void WaitDrain(atomic<long> &pending){
+    while( pending.load() != 0 )
+        this_thread::yield();
+}
+
+//  吞吐量：每次迭代提交一批任务并等待全部完成，参数为线程数；
+static void BM_ThreadPool_Throughput(benchmark::State &state){
+    const size_t threads = (size_t)state.range(0);
+    const long batch = 1000;
+    ThreadPool pool(threads , threads , threads , 1);
+    atomic<long> pending(0);
+    for(auto _ : state){
+        pending.store(batch);
+        for(long i=0;i<batch;i++)
+            pool.AddTask( new CountTask(&pending) );
+        WaitDrain(pending);
+    }
+    state.SetItemsProcessed( state.iterations() * batch );
+}
+BENCHMARK(BM_ThreadPool_Throughput)->Arg(1)->Arg(2)->Arg(4)->Arg(8)->UseRealTime()->Unit(benchmark::kMicrosecond);
+
+//  延迟：每次迭代提交单个任务并等待其完成，参数为线程数；
+static void BM_ThreadPool_Latency(benchmark::State &state){
+    const size_t threads = (size_t)state.range(0);
+    ThreadPool pool(threads , threads , threads , 1);
+    atomic<long> pending(0);
+    for(auto _ : state){
+        pending.store(1);
+        pool.AddTask( new CountTask(&pending) );
+        WaitDrain(pending);
+    }
+    state.SetItemsProcessed( state.iterations() );
+}
+BENCHMARK(BM_ThreadPool_Latency)->Arg(1)->Arg(2)->Arg(4)->Arg(8)->UseRealTime()->Unit(benchmark::kMicrosecond);
+
+//  绑核策略：4 线程下的吞吐量，并报告各线程 CPU 迁移次数之和，参数为 ThreadPool__Affinity::Policy；
+static void BM_ThreadPool_Affinity(benchmark::State &state){
+    const long batch = 1000;
+    ThreadPool pool(4 , 4 , 4 , 1 , ThreadPool__Affinity( (ThreadPool__Affinity::Policy)state.range(0) ));
+    atomic<long> pending(0);
+    for(auto _ : state){
+        pending.store(batch);
+        for(long i=0;i<batch;i++)
+            pool.AddTask( new CountTask(&pending) );
+        WaitDrain(pending);
+    }
+    size_t migrations = 0u;
+    for(auto &stat : pool.WorkerStats())
+        migrations += stat.migrations;
+    state.SetItemsProcessed( state.iterations() * batch );
+    state.counters["migrations"] = (double)migrations;
+}
+BENCHMARK(BM_ThreadPool_Affinity)->Arg(ThreadPool__Affinity::NONE)->Arg(ThreadPool__Affinity::COMPACT)
+    ->Arg(ThreadPool__Affinity::SCATTER)->UseRealTime()->Unit(benchmark::kMicrosecond);
+
+//  可调用对象吞吐量：Post 提交内联存储的 lambda，参数为线程数；
+static void BM_ThreadPool_PostThroughput(benchmark::State &state){
+    const size_t threads = (size_t)state.range(0);
+    const long batch = 1000;
+    ThreadPool pool(threads , threads , threads , 1);
+    atomic<long> pending(0);
+    for(auto _ : state){
+        pending.store(batch);
+        for(long i=0;i<batch;i++)
+            pool.Post( [&pending]{ pending.fetch_sub(1); } );
+        WaitDrain(pending);
+    }
+    state.SetItemsProcessed( state.iterations() * batch );
+}
+BENCHMARK(BM_ThreadPool_PostThroughput)->Arg(1)->Arg(2)->Arg(4)->Arg(8)->UseRealTime()->Unit(benchmark::kMicrosecond);
+
+//  Submit 延迟：提交单个 lambda 并经 future 取回结果，参数为线程数；
+static void BM_ThreadPool_SubmitLatency(benchmark::State &state){
+    const size_t threads = (size_t)state.range(0);
+    ThreadPool pool(threads , threads , threads , 1);
+    for(auto _ : state)
+        benchmark::DoNotOptimize( pool.Submit( []{ return 1; } ).get() );
+    state.SetItemsProcessed( state.iterations() );
+}
+BENCHMARK(BM_ThreadPool_SubmitLatency)->Arg(1)->Arg(4)->UseRealTime()->Unit(benchmark::kMicrosecond);
+
+//  ParallelFor：对 1M 元素求平方，参数为线程数；
+static void BM_ThreadPool_ParallelFor(benchmark::State &state){
+    const size_t threads = (size_t)state.range(0);
+    ThreadPool pool(threads , threads , threads , 1);
+    vector<double> data(1u << 20 , 1.5);
+    for(auto _ : state){
+        pool.ParallelFor(0u , data.size() , 16384u , [&data](size_t i){ data[i] *= data[i]; });
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed( state.iterations() * data.size() );
+}
+BENCHMARK(BM_ThreadPool_ParallelFor)->Arg(1)->Arg(2)->Arg(4)->UseRealTime()->Unit(benchmark::kMicrosecond);
+
+//  竞争提交：多个提交线程同时调用 AddTask（仅计提交耗时，迭代结束后等待队列排空）；
+static ThreadPool& SharedPool(){
+    static ThreadPool pool(4 , 4 , 4 , 1);
+    return pool;
+}
+static atomic<long> g_sharedPending(0);
+
+static void BM_ThreadPool_ContendedAddTask(benchmark::State &state){
+    ThreadPool &pool = SharedPool();
+    for(auto _ : state){
+        g_sharedPending.fetch_add(1);
+        pool.AddTask( new CountTask(&g_sharedPending) );
+    }
+    state.SetItemsProcessed( state.iterations() );
+    if( state.thread_index() == 0 )
+        WaitDrain(g_sharedPending);
+}
+BENCHMARK(BM_ThreadPool_ContendedAddTask)->ThreadRange(1,8)->UseRealTime();
+
+BENCHMARK_MAIN();
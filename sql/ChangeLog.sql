@@ -0,0 +1,76 @@
+-- ---------------------------------------------------------------------
+--  ChangeLog.sql :
+--      Change log behind the incremental sync opcode (OP_SYNC, "watermark#6";
+--      "#6" with no watermark asks for a full snapshot, 0 is an ordinary watermark).
+--      Every insert / update / delete on `test` appends one row to
+--      `test_changelog`; Seq is the watermark handed to clients.
+--
+--  Ordering guarantee:
+--      Seq is allocated when a change is written, but transactions may
+--      commit out of order, so rows below MAX(Seq) can still be invisible.
+--      The server therefore never hands out MAX(Seq). It uses the safe
+--      watermark: the largest Seq whose ChangedAt is more than
+--      SYNC_SAFETYWINDOW (1) second older than the start of every
+--      transaction still open on the primary (information_schema.innodb_trx).
+--      Every change with Seq <= safe watermark is committed or rolled back,
+--      so a client that syncs from a returned watermark never skips one.
+--      Deltas and index refreshes only read changes up to it.
+--  Consequences:
+--      - ChangedAt must be the time the row is written, hence SYSDATE(6)
+--        in the triggers (CURRENT_TIMESTAMP is the statement start time).
+--      - The change log is read on the primary, with an account that has
+--        the PROCESS privilege (needed for information_schema.innodb_trx).
+--      - A long open transaction holds the watermark back until it ends;
+--        clients then get fewer changes, never wrong ones.
+--
+--  Requires `test` to have an integer primary key `Id`.
+--  The table is seeded with one start row (Op 'N'), which the server skips.
+--  So MIN(Seq) is never above a transaction that was open when the table was created.
+--  A gap below MIN(Seq) can then only come from pruning.
+--  Old rows may be pruned (e.g. DELETE ... WHERE ChangedAt < NOW() - INTERVAL 30 DAY),
+--  but always keep the newest row: clients whose watermark is older than
+--  the oldest retained Seq get a full snapshot instead of a delta.
+--  Only prune rows older than any transaction can stay open.
+-- ---------------------------------------------------------------------
+
+CREATE TABLE IF NOT EXISTS test_changelog (
+    Seq       BIGINT UNSIGNED NOT NULL AUTO_INCREMENT,
+    Op        CHAR(1)         NOT NULL,            -- 'I' insert, 'U' update, 'D' delete, 'N' start row
+    DocId     INT             NOT NULL,
+    Year      INT             NULL,
+    Auther    VARCHAR(255)    NULL,
+    Title     VARCHAR(1024)   NULL,
+    ChangedAt TIMESTAMP(6)    NOT NULL DEFAULT CURRENT_TIMESTAMP(6),
+    PRIMARY KEY (Seq),
+    KEY idx_doc_seq (DocId, Seq)
+);
+
+-- Start row, only written into an empty log.
+INSERT INTO test_changelog (Op, DocId)
+    SELECT 'N', 0 FROM DUAL WHERE NOT EXISTS (SELECT 1 FROM test_changelog);
+
+DROP TRIGGER IF EXISTS test_after_insert;
+DROP TRIGGER IF EXISTS test_after_update;
+DROP TRIGGER IF EXISTS test_after_delete;
+
+DELIMITER //
+
+CREATE TRIGGER test_after_insert AFTER INSERT ON test FOR EACH ROW
+BEGIN
+    INSERT INTO test_changelog (Op, DocId, Year, Auther, Title, ChangedAt)
+        VALUES ('I', NEW.Id, NEW.Year, NEW.Auther, NEW.Title, SYSDATE(6));
+END //
+
+CREATE TRIGGER test_after_update AFTER UPDATE ON test FOR EACH ROW
+BEGIN
+    INSERT INTO test_changelog (Op, DocId, Year, Auther, Title, ChangedAt)
+        VALUES ('U', NEW.Id, NEW.Year, NEW.Auther, NEW.Title, SYSDATE(6));
+END //
+
+CREATE TRIGGER test_after_delete AFTER DELETE ON test FOR EACH ROW
+BEGIN
+    INSERT INTO test_changelog (Op, DocId, Year, Auther, Title, ChangedAt)
+        VALUES ('D', OLD.Id, NULL, NULL, NULL, SYSDATE(6));
+END //
+
+DELIMITER ;
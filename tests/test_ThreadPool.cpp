@@ -0,0 +1,108 @@
+//*********************************************************************
+//
+//  test_ThreadPool.cpp ：
+//      线程池测试：全部任务均被执行、按公平键轮转时长任务不阻塞其他键的任务、
+//                  空闲或饱和时 Exit 能及时返回；失败时输出原因并返回非零；
+//
+//*********************************************************************
+
+#include <iostream>
+#include <string>
+#include "ThreadPool.h"
+
+//  休眠任务：休眠指定毫秒后将完成计数加一；
+class SleepTask : public ThreadPool__Task{
+    public:
+        SleepTask(int ms , atomic<int>* done) : _ms_(ms),_done_(done){}
+        void Run(){
+            this_thread::sleep_for( chrono::milliseconds(_ms_) );
+            _done_->fetch_add(1);
+        }
+    private:
+        int _ms_;
+        atomic<int>* _done_;
+};
+
+static int failures = 0;
+
+//  检查条件，失败时记录；
+static void Check(bool condition , const string &message){
+    if( condition )
+        return;
+    cout << "FAILED: " << message << endl;
+    failures ++;
+}
+
+//  等待计数达到目标，超时返回 false；
+static bool WaitFor(atomic<int> &done , int target , int timeoutMs){
+    auto deadline = chrono::steady_clock::now() + chrono::milliseconds(timeoutMs);
+    while( done.load() < target ){
+        if( chrono::steady_clock::now() > deadline )
+            return false;
+        this_thread::sleep_for( chrono::milliseconds(1) );
+    }
+    return true;
+}
+
+//  不同公平键与可调用对象的任务全部执行；
+static void TestAllTasksRun(){
+    ThreadPool pool(4 , 2 , 2 , 1);
+    atomic<int> done(0);
+    for(int i=0;i<1000;i++){
+        pool.AddTask(new SleepTask(0 , &done) , (uint64_t)(i % 7));
+        pool.Post( [&done]{ done.fetch_add(1); } );
+    }
+    Check( WaitFor(done , 2000 , 10000) , "all tasks run: " + to_string(done.load()) + "/2000" );
+    pool.Exit();
+}
+
+//  公平：两个线程中的一个执行长任务，另一个键的短任务不应排在长任务之后；
+static void TestFairness(){
+    ThreadPool pool(2 , 2 , 2 , 1);
+    atomic<int> longDone(0) , shortDone(0);
+    pool.AddTask(new SleepTask(1000 , &longDone) , 1u);
+    this_thread::sleep_for( chrono::milliseconds(50) );
+    auto start = chrono::steady_clock::now();
+    for(int i=0;i<10;i++)
+        pool.AddTask(new SleepTask(1 , &shortDone) , 2u);
+    bool isDone = WaitFor(shortDone , 10 , 5000);
+    double ms = chrono::duration<double , milli>( chrono::steady_clock::now() - start ).count();
+    Check( isDone && ms < 500.0 , "short tasks waited behind the long task: " + to_string(ms) + " ms" );
+    Check( WaitFor(longDone , 1 , 5000) , "long task did not finish" );
+    pool.Exit();
+}
+
+//  空闲时与全部线程忙碌时退出均能及时返回（调度线程阻塞等待，Exit 将其唤醒）；
+static void TestExit(){
+    {
+        ThreadPool pool(2 , 1 , 1 , 1);
+        this_thread::sleep_for( chrono::milliseconds(20) );
+        auto start = chrono::steady_clock::now();
+        pool.Exit();
+        double ms = chrono::duration<double , milli>( chrono::steady_clock::now() - start ).count();
+        Check( ms < 1000.0 , "exit of an idle pool took " + to_string(ms) + " ms" );
+    }
+    {
+        ThreadPool pool(1 , 1 , 1 , 1);
+        atomic<int> done(0);
+        pool.AddTask(new SleepTask(200 , &done) , 1u);
+        pool.AddTask(new SleepTask(200 , &done) , 2u);
+        this_thread::sleep_for( chrono::milliseconds(20) );
+        auto start = chrono::steady_clock::now();
+        pool.Exit();
+        double ms = chrono::duration<double , milli>( chrono::steady_clock::now() - start ).count();
+        Check( ms < 2000.0 , "exit of a saturated pool took " + to_string(ms) + " ms" );
+    }
+}
+
+int main(){
+    TestAllTasksRun();
+    TestFairness();
+    TestExit();
+    if( failures != 0 ){
+        cout << failures << " check(s) failed" << endl;
+        return 1;
+    }
+    cout << "all checks passed" << endl;
+    return 0;
+}